@@ -0,0 +1,40 @@
+/*
+ *  Find out what is on the I2C bus
+ *
+ *  Circuit:  A standard Arduino with any mix of I2Cexpander supported devices.
+ *  Run it before the devices have been initialized (i.e., right after power-up).
+ *
+ *  Prints a device table that can be pasted into a sketch's setup(), and then
+ *  checks it against the table below.
+ *
+ *  Copyright (c) 2019 John Plocher, released under the terms of the MIT License (MIT)
+ */
+
+#include <Wire.h>
+#include <I2Cexpander.h>
+#include <I2Cdiscover.h>
+
+#define NUMPORTS 4 // 0..(NUMPORTS - 1)
+I2Cexpander m[NUMPORTS];
+I2Cdiscover bus;
+
+void setup()
+{
+    Serial.begin(19200);
+    Wire.begin();
+
+    bus.sweep();
+    bus.print();
+
+    m[ 0].init(0, I2Cexpander::PCF8574,  B11111111);  // 8x inputs
+    m[ 1].init(0, I2Cexpander::PCF8574A, B11111111);  // 8x inputs
+    m[ 2].init(0, I2Cexpander::MAX731x,  0xFFFF);     // 16 inputs
+    m[ 3].init(0, I2Cexpander::PCA9555,  0xFFFF);     // 16 inputs
+    if (bus.check(m, NUMPORTS) == 0) {
+        Serial.println("table matches the bus");
+    }
+}
+
+void loop()
+{
+}
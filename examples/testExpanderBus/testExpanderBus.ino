@@ -0,0 +1,49 @@
+/*
+ *  Test harness code for ExpanderBus
+ *
+ *  Circuit:  A standard Arduino with
+ *  2x I2C-8574 cards https://spcoast.github.io/pages/I2C-8574.html   and
+ *  2x I2C-7311 cards https://spcoast.github.io/pages/I2C-7311.html
+ *
+ *  Scans every expander in one pass and reports which ones changed,
+ *  along with how long the scan took.
+ *
+ *  Copyright (c) 2019 John Plocher, released under the terms of the MIT License (MIT)
+ */
+
+#include <Wire.h>
+#include <I2Cexpander.h>
+#include <ExpanderBus.h>
+
+#define NUMPORTS 6 // 0..(NUMPORTS - 1)
+I2Cexpander m[NUMPORTS];
+ExpanderBus bus(m, NUMPORTS);
+
+void setup()
+{
+    Serial.begin(19200);
+    Wire.begin();
+
+    m[ 5].init(1, I2Cexpander::MAX731x,  0xFFFF);     // 16 inputs
+    m[ 4].init(0, I2Cexpander::MAX731x,  0xFFFF);     // 16 inputs
+    m[ 3].init(1, I2Cexpander::PCF8574A, B11111111);  // 8x inputs
+    m[ 2].init(1, I2Cexpander::PCF8574,  B11111111);  // 8x inputs
+    m[ 1].init(0, I2Cexpander::PCF8574A, B11111111);  // 8x inputs
+    m[ 0].init(0, I2Cexpander::PCF8574,  B11111111);  // 8x inputs
+}
+
+void loop()
+{
+    if (bus.scan() == 0) {
+        return;     // nothing changed anywhere on the layout
+    }
+    Serial.print("scan took ");
+    Serial.print(bus.scanMicros());
+    Serial.println("uS");
+    for (int x = 0; x < bus.count(); x++) {
+        if (bus.changed(x)) {
+            Serial.print("  device ");   Serial.print(x);
+            Serial.print(" => 0x");      Serial.println(m[x].current(), HEX);
+        }
+    }
+}
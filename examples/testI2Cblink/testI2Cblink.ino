@@ -0,0 +1,40 @@
+/*
+ * MAX7313 blink and dimming test code
+ *
+ * 2019 John Plocher  SPCoast
+ *
+ * Drives 16 signal lamps on a MAX7313: the low byte steady, the high byte
+ * flashing, and pins 0-3 dimmed.  After setup() the only bus traffic is one
+ * 2-byte flip() per flash.
+ */
+
+#include <Wire.h>
+#include <I2Cexpander.h>
+#include <I2Cblink.h>
+
+#define FLASHRATE 500  // ms per phase
+
+I2Cexpander lamps;
+I2Cblink    flasher;
+
+void setup()
+{
+    Serial.begin(19200);
+    Wire.begin();
+    lamps.init(0, I2Cexpander::MAX731x, 0x0000);  // 0x10, 16 outputs
+    lamps.put(0xFFFF);                          // phase 0: everything lit
+
+    flasher.init(0);
+    flasher.phase1(0x00FF);                     // phase 1: the high byte dark
+    flasher.master(15);
+    for (int p = 0; p < 4; p++) {
+        flasher.intensity(p, 3);
+    }
+    flasher.blink(true);
+    flasher.flush();                            // 3 transactions
+}
+
+void loop() {
+    flasher.flip();
+    delay(FLASHRATE);
+}
@@ -0,0 +1,43 @@
+/*
+ * PCA9685 servo motion test code
+ *
+ * 2019 John Plocher  SPCoast
+ *
+ * Throws 8 turnout servos back and forth, each at its own speed with gentle
+ * starts and stops, while keeping the bus traffic of each update() under
+ * a budget.
+ */
+
+#include <Wire.h>
+#include <I2Cexpander.h>
+#include <I2Cpwm.h>
+#include <I2Cmotion.h>
+
+#define CLOSED  205     // ~1.0mS at 50Hz
+#define THROWN  410     // ~2.0mS
+
+I2Cpwm    board;
+I2Cmotion motion;
+uint8_t   points[8];
+
+void setup()
+{
+    Serial.begin(19200);
+    Wire.begin();
+    board.init(0);      // 0x40
+    for (int x = 0; x < 8; x++) {
+        points[x] = motion.add(board, x, CLOSED);
+    }
+    motion.budget(32);  // bytes per update()
+}
+
+void loop() {
+    static bool thrown = false;
+    if (!motion.moving()) {
+        thrown = !thrown;
+        for (int x = 0; x < 8; x++) {
+            motion.moveTo(points[x], thrown ? THROWN : CLOSED, 100 + 20 * x, 200);
+        }
+    }
+    motion.update();
+}
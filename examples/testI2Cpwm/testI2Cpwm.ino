@@ -0,0 +1,31 @@
+/*
+ * PCA9685 whole-chip test code
+ *
+ * 2019 John Plocher  SPCoast
+ *
+ * Fades all 16 channels of a PCA9685 LED controller up and down,
+ * updating the whole chip with a single flush() per step.
+ */
+
+#include <Wire.h>
+#include <I2Cexpander.h>
+#include <I2Cpwm.h>
+
+I2Cpwm leds;
+
+void setup()
+{
+    Serial.begin(19200);
+    Wire.begin();
+    leds.init(0);   // 0x40
+}
+
+void loop() {
+    for (int level = 0; level < 4096; level += 64) {
+        for (int c = 0; c < I2Cpwm::CHANNELS; c++) {
+            leds.set(c, (c & 1) ? level : 4095 - level);
+        }
+        leds.flush();   // 3 transactions for 16 channels on an AVR
+        delay(10);
+    }
+}
@@ -0,0 +1,334 @@
+/*!
+   @file bench.cpp
+
+   Bus-cost benchmark for I2Cexpander, run on the host simulator (extras/sim).
+
+   Every public operation is run against each chip type on the recording bus,
+   and its traffic reported: START, repeated START and STOP conditions, address
+   and data bytes, and the wire time at 100kHz, 400kHz and 1MHz.
+
+   The results are compared with a baseline file; any operation that costs more
+   bus clocks than its baseline fails the run (exit status 1).
+
+    <pre>
+    bench                       compare with extras/bench/baseline.csv
+    bench baseline.csv          compare with another baseline
+    bench --update [file]       (re)write the baseline
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cexpander.h"
+#include "I2Cdebounce.h"
+#include "I2Cpwm.h"
+#include "I2Cadda.h"
+#include "I2Cblink.h"
+#include "I2Cmotion.h"
+#include "ExpanderBus.h"
+#include "SimChip.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <map>
+
+SimPCA9555  c9555  (0x20);
+SimMCP23016 c23016 (0x22);
+SimMCP23017 c23017 (0x27);
+SimPCF8574  c8574  (0x21);
+SimPCF8574  c8574A (0x38);
+SimMAX731x  c731x  (0x10);
+SimPCA9685  c9685  (0x40);
+SimPCF8591  c8591  (0x48);
+SimTCA9548A muxA   (0x71);      // 0x70 is the PCA9685's ALLCALL address
+SimTCA9548A muxB   (0x72);
+SimTCA9548A muxC   (0x73);      // the scan sweep: 0x74 is a PCA9685 power-on SUBADR
+SimTCA9548A muxD   (0x75);
+
+/**
+ * One measured operation
+ */
+struct Result {
+    SimBusStats s;
+    uint32_t    us100k, us400k, us1M;
+};
+
+static std::map<std::string, Result> results;
+static std::string                   order[256];
+static int                           count = 0;
+
+template <class F>
+static void measure(const char *chip, const char *op, F f) {
+    Wire.resetStats();
+    f();
+    Result r;
+    r.s      = Wire.stats();
+    r.us100k = r.s.micros(100000);
+    r.us400k = r.s.micros(400000);
+    r.us1M   = r.s.micros(1000000);
+    std::string key = std::string(chip) + "," + op;
+    results[key] = r;
+    order[count++] = key;
+}
+
+/**
+ * The I2Cexpander API against one chip type
+ */
+struct Spec {
+    const char *name;
+    uint16_t    type;
+    uint16_t    config;     ///< inputs in the middle, outputs on both ends (8/16 bit), LED channel (PCA9685)
+    uint8_t     inPin;      ///< an input bit for digitalRead()
+    uint8_t     outPin;     ///< an output bit for digitalWrite()
+};
+
+static const Spec specs[] = {
+    { "PCA9555",  I2Cexpander::PCA9555,  0x0FF0, 8, 1 },
+    { "MCP23016", I2Cexpander::MCP23016, 0x0FF0, 8, 1 },
+    { "MCP23017", I2Cexpander::MCP23017, 0x0FF0, 8, 1 },
+    { "PCF8574",  I2Cexpander::PCF8574,  0x003C, 4, 1 },
+    { "PCF8574A", I2Cexpander::PCF8574A, 0x003C, 4, 1 },
+    { "MAX731x",  I2Cexpander::MAX731x,  0x0FF0, 8, 1 },
+    { "PCA9685",  I2Cexpander::PCA9685,  0x0003, 0, 0 },
+    { "PCF8591",  I2Cexpander::PCF8591,  0x0000, 0, 0 },
+};
+
+static void expander(const Spec &c) {
+    I2Cexpander m;
+    I2Cdebounce filter;
+
+    measure(c.name, "init",         [&] { m.init(0, c.type, c.config); });
+    m.policy(I2Cexpander::ELIDE_ALL);   // the rows below measure what elision saves
+    measure(c.name, "read",         [&] { m.read(); });
+    measure(c.name, "write",        [&] { m.write(0x0055); });
+    measure(c.name, "write.same",   [&] { m.write(0x0055); });
+    measure(c.name, "write.inputs", [&] { m.write(0x0FF5); });  // only input bits differ (16-bit chips)
+    measure(c.name, "write.partial",[&] { m.write(0x5FF5); });  // outputs in the high byte only (16-bit chips)
+    measure(c.name, "digitalRead",  [&] { m.digitalRead(c.inPin); });
+    measure(c.name, "digitalRead.x8", [&] { for (uint8_t b = 0; b < 8; b++) m.digitalRead(b); });
+    m.policy(I2Cexpander::ELIDE_ALL | I2Cexpander::CACHE_READS);
+    I2Cexpander::refresh();
+    measure(c.name, "cached.x8",    [&] { for (uint8_t b = 0; b < 8; b++) m.digitalRead(b); });
+    m.policy(I2Cexpander::ELIDE_ALL);
+    m.next = 0x5555;
+    measure(c.name, "digitalWrite", [&] { m.digitalWrite(c.outPin, !bitRead(m.next, c.outPin)); });
+    measure(c.name, "put.same",     [&] { m.put(); });
+    measure(c.name, "digitalWrite.x3", [&] { for (uint8_t b = 0; b < 3; b++) m.digitalWrite(b, !bitRead(m.next, b)); });
+    m.policy(I2Cexpander::ELIDE_ALL | I2Cexpander::DEFER_WRITES);
+    measure(c.name, "commit.x3",    [&] { for (uint8_t b = 0; b < 3; b++) m.digitalWrite(b, !bitRead(m.next, b)); m.commit(); });
+    m.policy(I2Cexpander::ELIDE_ALL);
+    m.debounce(&filter);
+    m.read();
+    measure(c.name, "read.debounced", [&] { m.read(); });
+}
+
+static void sweep(void);
+
+static void others(void) {
+    I2Cpwm pwm;
+    measure("I2Cpwm", "init",       [&] { pwm.init(0); });
+    pwm.flush();
+    measure("I2Cpwm", "flush.1",    [&] { pwm.set(0, 1000); pwm.flush(); });
+    measure("I2Cpwm", "flush.16",   [&] { for (uint8_t ch = 0; ch < I2Cpwm::CHANNELS; ch++) pwm.set(ch, 100 * ch); pwm.flush(); });
+
+    // 16 servos on their way, no more than 64 bytes per update
+    I2Cmotion motion;
+    for (uint8_t ch = 0; ch < I2Cpwm::CHANNELS; ch++) {
+        motion.add(pwm, ch, 1000);
+        motion.moveTo(ch, 2000 + 50 * ch, 500 + 20 * ch, 2000);
+    }
+    motion.budget(64);
+    motion.update();
+    delay(100);
+    measure("I2Cmotion", "update.16", [&] { motion.update(); });
+
+    I2Cadda adc;
+    adc.init(0);
+    measure("I2Cadda", "sample",    [&] { adc.sample(1); });
+    measure("I2Cadda", "sampleAll", [&] { adc.sampleAll(); });
+    adc.oversample(2);
+    measure("I2Cadda", "sampleAll.x16", [&] { adc.sampleAll(); });
+    uint8_t wave[64];
+    for (uint8_t x = 0; x < sizeof(wave); x++) wave[x] = x * 4;
+    measure("I2Cadda", "stream.64", [&] { adc.stream(wave, sizeof(wave)); });
+
+    I2Cblink blk;
+    measure("I2Cblink", "flush.init",   [&] { blk.init(0); blk.flush(); });
+    measure("I2Cblink", "flush.phase1", [&] { blk.phase1(0x00F0); blk.blink(true); blk.flush(); });
+    measure("I2Cblink", "flip",         [&] { blk.flip(); });
+    measure("I2Cblink", "flush.16",     [&] { for (uint8_t p = 0; p < I2Cblink::PINS; p++) blk.intensity(p, p); blk.flush(); });
+
+    I2Cexpander m[6];
+    m[0].init(0, I2Cexpander::PCA9555,  0xFFFF);
+    m[1].init(2, I2Cexpander::MCP23016, 0xFFFF);
+    m[2].init(7, I2Cexpander::MCP23017, 0xFFFF);
+    m[3].init(1, I2Cexpander::PCF8574,  0x00FF);
+    m[4].init(0, I2Cexpander::PCF8574A, 0x00FF);
+    m[5].init(0, I2Cexpander::MAX731x,  0xFFFF);
+    ExpanderBus bus(m, 6);
+    measure("ExpanderBus", "scan.6", [&] { bus.scan(); });
+    measure("ExpanderBus", "poll.6", [&] { bus.beginScan(); while (!bus.poll()) { } });
+
+    // 16 PCF8574s on 4 mux channels, listed channel-interleaved in the table
+    static SimPCF8574 *muxed[16];
+    I2Cexpander        mm[16];
+    for (uint8_t x = 0; x < 16; x++) {
+        uint8_t ch = x & 0x03, a = 4 + ((x >> 2) & 0x03);
+        muxed[x] = new SimPCF8574(0x20 + a);
+        muxed[x]->behind((ch < 2) ? &muxA : &muxB, ch & 1);
+        mm[x].init(I2Cexpander::muxed((ch < 2) ? 1 : 2, ch & 1, a), I2Cexpander::PCF8574, 0x00FF);
+    }
+    ExpanderBus mbus(mm, 16);
+    mbus.scan();
+    measure("ExpanderBus", "scan.mux16", [&] { mbus.scan(); });
+
+    sweep();
+}
+
+/**
+ * How scan() cost grows with the size of the table: PCF8574/As, 8 to a mux channel
+ * on addresses nothing else uses, across the 16 channels of muxC and muxD
+ */
+static const uint8_t sweeps[] = { 1, 8, 32, 128 };
+
+static void sweep(void) {
+    static SimChip *chips[128];
+    static I2Cexpander m[128];
+    for (uint8_t x = 0; x < 128; x++) {
+        uint8_t ch = x >> 3, a = x & 0x07;
+        uint8_t addr = (a < 4) ? 0x23 + a : 0x39 + (a - 4);
+        chips[x] = new SimPCF8574(addr);
+        chips[x]->behind((ch < 8) ? &muxC : &muxD, ch & 0x07);
+        m[x].init(I2Cexpander::muxed((ch < 8) ? 3 : 5, ch & 0x07, addr),
+                  (a < 4) ? I2Cexpander::PCF8574 : I2Cexpander::PCF8574A, 0x00FF);
+    }
+    for (uint8_t x = 0; x < sizeof(sweeps); x++) {
+        char op[16];
+        snprintf(op, sizeof(op), "scan.%u", sweeps[x]);
+        ExpanderBus bus(m, sweeps[x]);
+        bus.scan();
+        measure("ExpanderBus", op, [&] { bus.scan(); });
+    }
+}
+
+// Scan time per device, for the sweep
+static void sweepReport(void) {
+    printf("ExpanderBus scan time, per device:\n");
+    for (uint8_t x = 0; x < sizeof(sweeps); x++) {
+        char key[32];
+        snprintf(key, sizeof(key), "ExpanderBus,scan.%u", sweeps[x]);
+        const Result &r = results[key];
+        printf("  %3u devices  %7uus  %5uus/device at 400kHz, %6uus  %5uus/device at 1MHz\n", sweeps[x],
+               r.us400k, r.us400k / sweeps[x], r.us1M, r.us1M / sweeps[x]);
+    }
+    printf("\n");
+}
+
+/*
+***************************************************************************
+**                        Baseline file                                  **
+***************************************************************************
+ */
+
+static const char *HEADER = "chip,op,starts,restarts,stops,addr,data,bits,us100k,us400k,us1M";
+
+static void save(const char *file) {
+    FILE *f = fopen(file, "w");
+    if (!f) {
+        perror(file);
+        exit(2);
+    }
+    fprintf(f, "%s\n", HEADER);
+    for (int x = 0; x < count; x++) {
+        const Result &r = results[order[x]];
+        fprintf(f, "%s,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", order[x].c_str(),
+                r.s.starts, r.s.restarts, r.s.stops, r.s.addrBytes, r.s.dataBytes, r.s.bits(),
+                r.us100k, r.us400k, r.us1M);
+    }
+    fclose(f);
+}
+
+// Compare with the baseline: more bus clocks, or more transactions, is a regression
+static int compare(const char *file) {
+    FILE *f = fopen(file, "r");
+    if (!f) {
+        perror(file);
+        fprintf(stderr, "(run with --update to create it)\n");
+        return 2;
+    }
+    char line[256];
+    int  regressions = 0, improvements = 0, seen = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char     chip[32], op[32];
+        unsigned starts, restarts, stops, addr, data, bits;
+        if (sscanf(line, "%31[^,],%31[^,],%u,%u,%u,%u,%u,%u", chip, op,
+                   &starts, &restarts, &stops, &addr, &data, &bits) != 8) {
+            continue;   // header
+        }
+        std::string key = std::string(chip) + "," + op;
+        if (!results.count(key)) {
+            printf("MISSING     %-12s %-16s (in baseline, not measured)\n", chip, op);
+            regressions++;
+            continue;
+        }
+        seen++;
+        const SimBusStats &s = results[key].s;
+        if (s.bits() > bits || s.addrBytes > addr) {
+            printf("REGRESSION  %-12s %-16s bits %u -> %u, transactions %u -> %u\n",
+                   chip, op, bits, s.bits(), addr, s.addrBytes);
+            regressions++;
+        } else if (s.bits() < bits) {
+            printf("improved    %-12s %-16s bits %u -> %u\n", chip, op, bits, s.bits());
+            improvements++;
+        }
+    }
+    fclose(f);
+    if (seen < count) {
+        printf("%d operation(s) not in the baseline\n", count - seen);
+    }
+    if (improvements && !regressions) {
+        printf("run with --update to lock in the improvements\n");
+    }
+    if (regressions) {
+        printf("\n*** %d BUS COST REGRESSION(S) against %s ***\n", regressions, file);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bool        update = false;
+    const char *file   = "extras/bench/baseline.csv";
+    for (int x = 1; x < argc; x++) {
+        if (strcmp(argv[x], "--update") == 0) update = true;
+        else                                  file   = argv[x];
+    }
+
+    Wire.begin();
+    for (size_t x = 0; x < sizeof(specs) / sizeof(specs[0]); x++) {
+        expander(specs[x]);
+    }
+    others();
+
+    printf("%-12s %-16s %6s %6s %6s %6s %6s %8s %8s %8s\n",
+           "chip", "op", "START", "Sr", "STOP", "addr", "data", "100kHz", "400kHz", "1MHz");
+    for (int x = 0; x < count; x++) {
+        const Result &r = results[order[x]];
+        std::string chip = order[x].substr(0, order[x].find(','));
+        std::string op   = order[x].substr(order[x].find(',') + 1);
+        printf("%-12s %-16s %6u %6u %6u %6u %6u %6uus %6uus %6uus\n", chip.c_str(), op.c_str(),
+               r.s.starts, r.s.restarts, r.s.stops, r.s.addrBytes, r.s.dataBytes,
+               r.us100k, r.us400k, r.us1M);
+    }
+    printf("\n");
+    sweepReport();
+
+    if (update) {
+        save(file);
+        printf("baseline written to %s\n", file);
+        return 0;
+    }
+    return compare(file);
+}
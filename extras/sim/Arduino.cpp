@@ -0,0 +1,127 @@
+/*!
+   @file Arduino.cpp
+
+   Host stand-in for the Arduino core: simulated time, pins and Serial.
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "Arduino.h"
+#include "SimChip.h"
+#include <stdio.h>
+
+HardwareSerial Serial;
+
+static uint64_t _now;               // simulated nanoseconds
+static uint8_t  _mode[SIM_PINS];    // pinMode()
+static uint8_t  _latch[SIM_PINS];   // digitalWrite() (or the pullup when an INPUT)
+static uint8_t  _driven[SIM_PINS];  // is something outside the sketch driving the pin?
+static uint8_t  _level[SIM_PINS];   // ... and to what level
+static int      _analog[SIM_PINS];
+
+void simAdvance(uint32_t ns)        { _now += ns; }
+uint64_t simNanos(void)             { return _now; }
+
+unsigned long millis(void)          { return (unsigned long)(_now / 1000000UL); }
+unsigned long micros(void)          { return (unsigned long)(_now / 1000UL); }
+void delay(unsigned long ms)        { _now += (uint64_t)ms * 1000000UL; }
+void delayMicroseconds(unsigned int us) { _now += (uint64_t)us * 1000UL; }
+void yield(void)                    { }
+void noInterrupts(void)             { }
+void interrupts(void)               { }
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= SIM_PINS) return;
+    _mode[pin] = mode;
+    if (mode == INPUT_PULLUP) _latch[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= SIM_PINS) return;
+    _latch[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= SIM_PINS) return LOW;
+    SimChip::tick();                // let scripted inputs (and INT outputs) catch up to now
+    if (_driven[pin] && _mode[pin] != OUTPUT) {
+        return _level[pin];
+    }
+    return _latch[pin];
+}
+
+int analogRead(uint8_t pin) {
+    if (pin >= SIM_PINS) return 0;
+    return _analog[pin];
+}
+
+void analogWrite(uint8_t pin, int val) {
+    if (pin >= SIM_PINS) return;
+    _mode[pin]  = OUTPUT;
+    _latch[pin] = (val >= 128) ? HIGH : LOW;
+}
+
+void simPin(uint8_t pin, uint8_t level) {
+    if (pin >= SIM_PINS) return;
+    _driven[pin] = 1;
+    _level[pin]  = level ? HIGH : LOW;
+}
+
+void simRelease(uint8_t pin) {
+    if (pin >= SIM_PINS) return;
+    _driven[pin] = 0;
+}
+
+uint8_t simLatch(uint8_t pin) {
+    if (pin >= SIM_PINS) return LOW;
+    return _latch[pin];
+}
+
+void simAnalog(uint8_t pin, int value) {
+    if (pin >= SIM_PINS) return;
+    _analog[pin] = value;
+}
+
+/*
+***************************************************************************
+**                        Serial                                         **
+***************************************************************************
+ */
+
+size_t HardwareSerial::write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::print(const char *s) {
+    return fputs(s, stdout) < 0 ? 0 : strlen(s);
+}
+
+size_t HardwareSerial::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(long n, int base) {
+    if (base == DEC && n < 0) {
+        return print('-') + print((unsigned long)-n, DEC);
+    }
+    return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+    char buf[8 * sizeof(long) + 1];
+    char *s = &buf[sizeof(buf) - 1];
+    *s = '\0';
+    if (base < 2) base = DEC;
+    do {
+        uint8_t d = n % base;
+        n /= base;
+        *--s = (d < 10) ? '0' + d : 'A' + d - 10;
+    } while (n);
+    return print(s);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+    return printf("%.*f", digits, n);
+}
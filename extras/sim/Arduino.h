@@ -0,0 +1,143 @@
+/*!
+ * @file Arduino.h
+ *
+ * Host (Linux/macOS) stand-in for the Arduino core, just enough to compile and run I2Cexpander on a PC
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Time is simulated: it only moves forward when the sketch calls delay() or
+ *  when the simulated Wire bus clocks bits, so every run is repeatable.
+ *  Pins are an array of levels that the test program can drive with simPin().
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool            boolean;
+typedef uint8_t         byte;
+typedef unsigned int    word;
+
+#define HIGH            0x1
+#define LOW             0x0
+
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+
+#define DEC             10
+#define HEX             16
+#define OCT             8
+#define BIN             2
+
+#define A0              14
+#define A1              15
+#define A2              16
+#define A3              17
+#define A4              18
+#define A5              19
+#define A6              20
+#define A7              21
+
+/** How many simulated Arduino pins */
+#define SIM_PINS        64
+
+#define bitRead(value, bit)            (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)             ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)           ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define bit(b)                         (1UL << (b))
+
+#define F(string_literal)              (string_literal)
+
+unsigned long millis(void);
+unsigned long micros(void);
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+void          yield(void);
+
+void          pinMode(uint8_t pin, uint8_t mode);
+void          digitalWrite(uint8_t pin, uint8_t val);
+int           digitalRead(uint8_t pin);
+int           analogRead(uint8_t pin);
+void          analogWrite(uint8_t pin, int val);
+
+void          noInterrupts(void);
+void          interrupts(void);
+
+/**
+ * Serial output goes to stdout
+ */
+class HardwareSerial {
+public:
+    void   begin(unsigned long baud)                { };
+    void   end(void)                                { };
+    void   flush(void)                              { };
+    operator bool()                                 { return true; };
+
+    size_t write(uint8_t c);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC)   { return print((unsigned long)n, base); };
+    size_t print(int n, int base = DEC)             { return print((long)n, base); };
+    size_t print(unsigned int n, int base = DEC)    { return print((unsigned long)n, base); };
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(void)                            { return print('\n'); };
+    template <class T>
+    size_t println(T v)                             { size_t n = print(v); return n + println(); };
+    template <class T>
+    size_t println(T v, int base)                   { size_t n = print(v, base); return n + println(); };
+};
+
+extern HardwareSerial Serial;
+
+/*
+***************************************************************************
+**                        Simulation controls                            **
+***************************************************************************
+ */
+
+/**
+ * Move simulated time forward
+ * @param ns    nanoseconds
+ */
+void          simAdvance(uint32_t ns);
+/**
+ * Simulated time since the program started
+ * @return nanoseconds
+ */
+uint64_t      simNanos(void);
+/**
+ * Drive a pin from outside the sketch (a button, sensor or another chip's INT output)
+ * @param pin
+ * @param level HIGH or LOW
+ */
+void          simPin(uint8_t pin, uint8_t level);
+/**
+ * Stop driving a pin; it goes back to its pullup (HIGH) or output latch
+ * @param pin
+ */
+void          simRelease(uint8_t pin);
+/**
+ * What the sketch has written to an OUTPUT pin
+ * @param pin
+ * @return HIGH or LOW
+ */
+uint8_t       simLatch(uint8_t pin);
+/**
+ * Set the value analogRead() returns for a pin
+ * @param pin
+ * @param value [0..1023]
+ */
+void          simAnalog(uint8_t pin, int value);
+
+#endif // Arduino_h
@@ -0,0 +1,436 @@
+/*!
+   @file SimChip.cpp
+
+   Behavioural models of the I2C chips I2Cexpander supports.
+
+   Only what the chips do on the bus is modelled - register files, pointer
+   auto-increment rules, pin levels, interrupt flags - not their analog
+   behaviour or timing.  Input scripts are applied lazily: whenever the bus
+   is used or a pin is read, every chip catches up to the current simulated
+   time.
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "SimChip.h"
+
+SimChip *SimChip::_first = NULL;
+
+SimChip::SimChip(uint8_t address) {
+    _address    = address;
+    _input      = 0xFFFFFFFFUL;     // pulled up, nothing driving the pins
+    _index      = 0;
+    _stuckMask  = 0;
+    _stuckValue = 0;
+    _absent     = false;
+    _nackCount  = 0;
+    _nackData   = -1;
+    _reads      = 0;
+    _writes     = 0;
+    _script     = NULL;
+    _steps      = 0;
+    _step       = 0;
+    _repeat     = false;
+    _origin     = 0;
+    _mux        = NULL;
+    _channel    = 0;
+
+    // append, so chips are visited in declaration order
+    _next = NULL;
+    SimChip **p = &_first;
+    while (*p) p = &(*p)->_next;
+    *p = this;
+}
+
+SimChip::~SimChip() {
+    for (SimChip **p = &_first; *p; p = &(*p)->_next) {
+        if (*p == this) {
+            *p = _next;
+            break;
+        }
+    }
+}
+
+void SimChip::input(uint32_t value) {
+    _input = value;
+    update();
+}
+
+void SimChip::script(const SimInput *steps, uint16_t count, bool repeat) {
+    _script = steps;
+    _steps  = count;
+    _step   = 0;
+    _repeat = repeat && count > 1 && steps[count - 1].at > 0;
+    _origin = simNanos();
+    tick();
+}
+
+// With repeat, the last step marks the end of the cycle: the script starts
+// over from its first step at that time.
+void SimChip::tick(void) {
+    uint64_t now = simNanos();
+    for (SimChip *c = _first; c; c = c->_next) {
+        bool changed = false;
+        while (c->_script && c->_step < c->_steps &&
+               c->_origin + (uint64_t)c->_script[c->_step].at * 1000UL <= now) {
+            c->_input = c->_script[c->_step].value;
+            changed   = true;
+            if (++c->_step == c->_steps && c->_repeat) {
+                c->_origin += (uint64_t)c->_script[c->_steps - 1].at * 1000UL;
+                c->_step    = 0;
+            }
+        }
+        if (changed) {
+            c->update();
+        }
+    }
+}
+
+bool SimChip::attach(uint8_t address, bool read) {
+    if (_absent || !routed() || !match(address)) {
+        return false;
+    }
+    if (_nackCount) {
+        _nackCount--;
+        return false;
+    }
+    _index = 0;
+    if (read) _reads++;
+    else      _writes++;
+    begin(read);
+    return true;
+}
+
+bool SimChip::routed(void) {
+    return !_mux || ((_mux->control() & (1 << _channel)) && _mux->routed());
+}
+
+bool SimChip::receive(uint8_t data) {
+    if (_nackData == _index) {
+        _index++;
+        return false;
+    }
+    writeByte(data, _index++);
+    return true;
+}
+
+/*
+***************************************************************************
+**                                  16 b i t  9555                       **
+***************************************************************************
+ */
+
+SimPCA9555::SimPCA9555(uint8_t address) : SimChip(address) {
+    _reg[0] = _reg[1] = 0x00;   // INPUT
+    _reg[2] = _reg[3] = 0xFF;   // OUTPUT
+    _reg[4] = _reg[5] = 0x00;   // POLARITY
+    _reg[6] = _reg[7] = 0xFF;   // CONFIG, all inputs
+    _ptr    = 0;
+}
+
+uint32_t SimPCA9555::pins(void) {
+    uint16_t out = _reg[2] | (_reg[3] << 8);
+    uint16_t cfg = _reg[6] | (_reg[7] << 8);
+    return applyStuck((out & ~cfg) | (_input & cfg)) & 0xFFFF;
+}
+
+void SimPCA9555::writeByte(uint8_t data, uint8_t index) {
+    if (index == 0) {
+        _ptr = data & 0x07;
+        return;
+    }
+    uint8_t r = writable(_ptr);
+    if (r != 0xFF) {
+        _reg[r] = data;
+    }
+    _ptr ^= 1;                  // the other register of the pair
+}
+
+uint8_t SimPCA9555::readByte(void) {
+    uint8_t v;
+    if (_ptr < 2) {
+        v = (pins() >> (8 * _ptr)) ^ _reg[4 + _ptr];
+    } else {
+        v = _reg[_ptr];
+    }
+    _ptr ^= 1;
+    return v;
+}
+
+/*
+***************************************************************************
+**                                  16 b i t  731x                       **
+***************************************************************************
+ */
+
+SimMAX731x::SimMAX731x(uint8_t address) : SimChip(address) {
+    memset(_reg, 0, sizeof(_reg));
+    _reg[0x02] = _reg[0x03] = 0xFF;     // blink phase 0 outputs
+    _reg[0x06] = _reg[0x07] = 0xFF;     // ports configuration, all inputs
+    _reg[0x0A] = _reg[0x0B] = 0xFF;     // blink phase 1 outputs
+    _reg[0x0E] = 0xFF;                  // master, O16 intensity
+    for (uint8_t r = 0x10; r < 0x18; r++) {
+        _reg[r] = 0xFF;                 // outputs intensity
+    }
+    _ptr = 0;
+}
+
+uint32_t SimMAX731x::pins(void) {
+    uint8_t  phase = ((_reg[0x0F] & 0x03) == 0x03) ? 0x0A : 0x02;   // blink enabled and flipped
+    uint16_t out   = _reg[phase] | (_reg[phase + 1] << 8);
+    uint16_t cfg   = _reg[0x06] | (_reg[0x07] << 8);
+    return applyStuck((out & ~cfg) | (_input & cfg)) & 0xFFFF;
+}
+
+uint8_t SimMAX731x::intensity(uint8_t pin) {
+    uint8_t master = _reg[0x0E] >> 4;
+    if (master == 0) {
+        return 15;                      // PWM off, static outputs
+    }
+    if (_reg[0x0F] & 0x04) {
+        return _reg[0x0E] & 0x0F;       // global intensity
+    }
+    uint8_t r = _reg[0x10 + ((pin & 0x0F) >> 1)];
+    return (pin & 1) ? (r >> 4) : (r & 0x0F);
+}
+
+// Register pairs below 0x10, the intensity block 0x10-0x17 wraps on itself
+void SimMAX731x::step(void) {
+    if (_ptr < 0x10) {
+        _ptr ^= 1;
+    } else {
+        _ptr = 0x10 + ((_ptr + 1) & 0x07);
+    }
+}
+
+void SimMAX731x::writeByte(uint8_t data, uint8_t index) {
+    if (index == 0) {
+        _ptr = data % sizeof(_reg);
+        return;
+    }
+    if (_ptr >= 0x02) {
+        _reg[_ptr] = data;
+    }
+    step();
+}
+
+uint8_t SimMAX731x::readByte(void) {
+    uint8_t v = (_ptr < 2) ? (pins() >> (8 * _ptr)) : _reg[_ptr];
+    step();
+    return v;
+}
+
+/*
+***************************************************************************
+**                                  16 b i t  23017                      **
+***************************************************************************
+ */
+
+enum {
+    IODIRA = 0x00, IPOLA = 0x02, GPINTENA = 0x04, DEFVALA = 0x06, INTCONA = 0x08,
+    IOCONA = 0x0A, IOCONB = 0x0B, GPPUA = 0x0C, INTFA = 0x0E, INTFB = 0x0F,
+    INTCAPA = 0x10, INTCAPB = 0x11, GPIOA = 0x12, GPIOB = 0x13, OLATA = 0x14, OLATB = 0x15
+};
+
+SimMCP23017::SimMCP23017(uint8_t address) : SimChip(address) {
+    memset(_reg, 0, sizeof(_reg));
+    _reg[IODIRA] = _reg[IODIRA + 1] = 0xFF;
+    _ptr    = 0;
+    _intPin = -1;
+    _prev   = pins();
+}
+
+uint32_t SimMCP23017::pins(void) {
+    uint16_t dir = pair(IODIRA);
+    return applyStuck((pair(OLATA) & ~dir) | (_input & dir)) & 0xFFFF;
+}
+
+// Inputs changed: flag and capture interrupt-on-change / compare-to-DEFVAL pins
+void SimMCP23017::update(void) {
+    uint16_t cur  = pins();
+    uint16_t con  = pair(INTCONA);
+    uint16_t hit  = pair(GPINTENA) & pair(IODIRA) &
+                    ((con & (cur ^ pair(DEFVALA))) | (~con & (cur ^ _prev)));
+    for (uint8_t port = 0; port < 2; port++) {
+        uint8_t h = hit >> (8 * port);
+        if (h && _reg[INTFA + port] == 0) {     // INTCAP holds the first event until cleared
+            _reg[INTFA + port]   = h;
+            _reg[INTCAPA + port] = cur >> (8 * port);
+        }
+    }
+    _prev = cur;
+    signal();
+}
+
+void SimMCP23017::signal(void) {
+    if (_intPin < 0) {
+        return;
+    }
+    uint8_t iocon  = _reg[IOCONA];
+    bool    active = (_reg[INTFA] != 0) || ((iocon & 0x40) && (_reg[INTFB] != 0));
+    if (iocon & 0x04) {                         // ODR: open drain, active low
+        if (active) simPin(_intPin, LOW);
+        else        simRelease(_intPin);
+    } else {
+        bool high = (iocon & 0x02) ? active : !active;
+        simPin(_intPin, high ? HIGH : LOW);
+    }
+}
+
+void SimMCP23017::writeByte(uint8_t data, uint8_t index) {
+    if (index == 0) {
+        _ptr = data % sizeof(_reg);
+        return;
+    }
+    switch (_ptr) {
+        case IOCONA:
+        case IOCONB:    _reg[IOCONA] = _reg[IOCONB] = data & ~0x01;     break;
+        case INTFA:
+        case INTFB:
+        case INTCAPA:
+        case INTCAPB:                                                   break;  // read only
+        case GPIOA:
+        case GPIOB:     _reg[_ptr + 2] = data;                          break;  // to OLAT
+        default:        _reg[_ptr] = data;                              break;
+    }
+    _prev = pins();
+    signal();
+    if (!(_reg[IOCONA] & 0x20)) {               // SEQOP clear: sequential
+        _ptr = (_ptr + 1) % sizeof(_reg);
+    }
+}
+
+uint8_t SimMCP23017::readByte(void) {
+    uint8_t v;
+    uint8_t port = _ptr & 1;
+    switch (_ptr) {
+        case GPIOA:
+        case GPIOB:
+            v = (pins() >> (8 * port)) ^ (_reg[IPOLA + port] & _reg[IODIRA + port]);
+            _reg[INTFA + port] = 0;             // reading GPIO or INTCAP clears the interrupt
+            update();                           // (DEFVAL compares re-assert right away)
+            break;
+        case INTCAPA:
+        case INTCAPB:
+            v = _reg[_ptr];
+            _reg[INTFA + port] = 0;
+            update();
+            break;
+        default:
+            v = _reg[_ptr];
+            break;
+    }
+    if (!(_reg[IOCONA] & 0x20)) {
+        _ptr = (_ptr + 1) % sizeof(_reg);
+    }
+    return v;
+}
+
+/*
+***************************************************************************
+**                                  ADC / DAC                            **
+***************************************************************************
+ */
+
+void SimPCF8591::writeByte(uint8_t data, uint8_t index) {
+    if (index == 0) {
+        _control = data;
+        _channel = data & 0x03;
+    } else {
+        _dac = data;
+    }
+}
+
+// The first byte of a read is the previous conversion; each byte sent starts the next one.
+uint8_t SimPCF8591::readByte(void) {
+    uint8_t v = _result;
+    _result = analog(_channel);
+    if (_control & 0x04) {
+        _channel = (_channel + 1) & 0x03;
+    }
+    return v;
+}
+
+/*
+***************************************************************************
+**                        16 b i t  9685 LED PWM driver                  **
+***************************************************************************
+ */
+
+enum {
+    MODE1 = 0x00, MODE2 = 0x01, SUBADR1 = 0x02, SUBADR2 = 0x03, SUBADR3 = 0x04, ALLCALLADR = 0x05,
+    LED0 = 0x06, LAST_LED = 0x45, ALL_LED = 0xFA, PRE_SCALE = 0xFE
+};
+
+SimPCA9685::SimPCA9685(uint8_t address) : SimChip(address) {
+    memset(_reg, 0, sizeof(_reg));
+    _reg[MODE1]      = 0x11;        // SLEEP, ALLCALL
+    _reg[MODE2]      = 0x04;        // OUTDRV
+    _reg[SUBADR1]    = 0xE2;
+    _reg[SUBADR2]    = 0xE4;
+    _reg[SUBADR3]    = 0xE8;
+    _reg[ALLCALLADR] = 0xE0;
+    for (uint8_t ch = 0; ch < 16; ch++) {
+        _reg[LED0 + 4 * ch + 3] = 0x10;     // FULL OFF
+    }
+    _reg[PRE_SCALE]  = 0x1E;
+    _ptr = 0;
+}
+
+bool SimPCA9685::match(uint8_t address) {
+    uint8_t m = _reg[MODE1];
+    return (address == _address) ||
+           ((m & 0x01) && address == (_reg[ALLCALLADR] >> 1)) ||
+           ((m & 0x08) && address == (_reg[SUBADR1] >> 1)) ||
+           ((m & 0x04) && address == (_reg[SUBADR2] >> 1)) ||
+           ((m & 0x02) && address == (_reg[SUBADR3] >> 1));
+}
+
+void SimPCA9685::step(void) {
+    if (_reg[MODE1] & 0x20) {       // AI
+        _ptr = (_ptr == LAST_LED) ? MODE1 : _ptr + 1;
+    }
+}
+
+void SimPCA9685::writeByte(uint8_t data, uint8_t index) {
+    if (index == 0) {
+        _ptr = data;
+        return;
+    }
+    if (_ptr >= ALL_LED && _ptr < PRE_SCALE) {
+        for (uint8_t ch = 0; ch < 16; ch++) {
+            _reg[LED0 + 4 * ch + (_ptr - ALL_LED)] = data;
+        }
+    } else if (_ptr == MODE1) {
+        _reg[MODE1] = data & ~0x80;             // writing RESTART clears it
+    } else if (_ptr == PRE_SCALE) {
+        if (_reg[MODE1] & 0x10) {               // only while asleep
+            _reg[PRE_SCALE] = data;
+        }
+    } else {
+        _reg[_ptr] = data;
+    }
+    step();
+}
+
+uint8_t SimPCA9685::readByte(void) {
+    uint8_t v = (_ptr >= ALL_LED && _ptr < PRE_SCALE) ? 0 : _reg[_ptr];    // ALL_LED reads as 0
+    step();
+    return v;
+}
+
+void SimPCA9685::led(uint8_t channel, uint16_t &on, uint16_t &off) {
+    uint8_t r = LED0 + 4 * (channel & 0x0F);
+    on  = _reg[r]     | (_reg[r + 1] << 8);
+    off = _reg[r + 2] | (_reg[r + 3] << 8);
+}
+
+uint16_t SimPCA9685::duty(uint8_t channel) {
+    uint16_t on, off;
+    led(channel, on, off);
+    if (off & 0x1000) return 0;                 // FULL OFF wins
+    if (on  & 0x1000) return 4096;
+    return ((off & 0x0FFF) - (on & 0x0FFF)) & 0x0FFF;
+}
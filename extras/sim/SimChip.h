@@ -0,0 +1,391 @@
+/*!
+ * @file SimChip.h
+ *
+ * Behavioural models of the I2C chips I2Cexpander supports, for the host Wire stand-in
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Declaring a model puts it on the simulated bus:
+ *
+ *  <pre>
+ *  SimPCA9555 signals(0x20);
+ *  SimPCF8574 buttons(0x21);
+ *
+ *  buttons.input(0xFE);                    // someone is pressing button 0
+ *  signals.stuck(0x0100, 0);               // a shorted output
+ *  signals.nackNext(3);                    // a noisy bus
+ *
+ *  static const SimInput bounce[] = { {0, 0xFF}, {200, 0xFE}, {350, 0xFF}, {600, 0xFE} };
+ *  buttons.script(bounce, 4);              // µS after script() => pin levels
+ *  </pre>
+ *
+ *  Each model keeps the chip's register file and pointer behaviour (register pairs,
+ *  auto-increment, power-on defaults), so the real I2Cexpander.cpp talks to it
+ *  exactly as it would to hardware.
+ */
+
+#ifndef SimChip_h
+#define SimChip_h
+
+#include "Arduino.h"
+
+/**
+ * One step of an input script
+ */
+struct SimInput {
+    uint32_t at;        ///< µS after script() was called
+    uint32_t value;     ///< external pin levels (or A/D values) from then on
+};
+
+class SimTCA9548A;
+
+/**
+ * A device on the simulated bus:
+ *    input() / script()
+ *    stuck()
+ *    nack() / nackNext()
+ *    pins()
+ */
+class SimChip {
+public:
+    /*!
+        @brief  Put a chip on the bus
+        @param    address
+                  7-bit I2C address
+    */
+    SimChip(uint8_t address);
+    virtual ~SimChip();
+
+    /*!
+        @brief  Drive the chip's input pins from outside
+        @param    value
+                  pin levels (for the PCF8591, four 8-bit A/D inputs, channel 0 in the low byte)
+    */
+    void     input(uint32_t value);
+    /*!
+        @brief  Change the inputs over (simulated) time
+        @param    steps
+                  {µS, value} pairs in time order; the array must outlive the script
+        @param    count
+                  how many steps
+        @param    repeat
+                  start over after the last step?
+    */
+    void     script(const SimInput *steps, uint16_t count, bool repeat = false);
+    /*!
+        @brief  Force pins to a level, whatever the chip or the outside world is doing
+        @param    mask
+                  which pins
+        @param    value
+                  their levels
+    */
+    void     stuck(uint32_t mask, uint32_t value)   { _stuckMask = mask; _stuckValue = value; update(); };
+    /*!
+        @brief  Take the chip off the bus (or put it back): every address phase is NACKed
+        @param    absent
+    */
+    void     nack(bool absent)                      { _absent = absent; };
+    /*!
+        @brief  NACK the next few address phases, then recover
+        @param    count
+    */
+    void     nackNext(uint16_t count)               { _nackCount = count; };
+    /*!
+        @brief  NACK a data byte written to the chip
+        @param    index
+                  which byte of each write transaction (0 is the first byte after the address), -1 for none
+    */
+    void     nackData(int16_t index)                { _nackData = index; };
+    /*!
+        @brief  Put the chip on a mux channel: it only sees the bus while that channel is selected
+        @param    mux
+        @param    channel
+                  [0..7]
+    */
+    void     behind(SimTCA9548A *mux, uint8_t channel)  { _mux = mux; _channel = channel; };
+
+    /*!
+        @brief  The levels on the chip's pins, as the outside world sees them
+        @return pin levels
+    */
+    virtual uint32_t pins(void)                     { return applyStuck(_input); };
+
+    uint8_t  address(void)                          { return _address; };  ///< 7-bit I2C address
+    uint32_t reads(void)                            { return _reads; };    ///< read transactions ACKed
+    uint32_t writes(void)                           { return _writes; };   ///< write transactions ACKed
+
+    /*
+    ***************************************************************************
+    **                        Bus side, called by TwoWire                    **
+    ***************************************************************************
+     */
+
+    /*!
+        @brief  Address phase
+        @param    address
+                  7-bit address on the bus
+        @param    read
+                  R/W bit
+        @return true if the chip ACKs
+    */
+    bool     attach(uint8_t address, bool read);
+    /*!
+        @brief  Master wrote a data byte
+        @param    data
+        @return true if the chip ACKs
+    */
+    bool     receive(uint8_t data);
+    /*!
+        @brief  Master reads a data byte
+        @return the byte
+    */
+    uint8_t  send(void)                             { return readByte(); };
+    /*!
+        @brief  STOP or repeated START
+    */
+    void     detach(void)                           { end(); };
+
+    /// First chip on the bus
+    static SimChip *first(void)                     { return _first; };
+    /// Next chip on the bus
+    SimChip *next(void)                             { return _next; };
+    /// Apply any scripted input changes that are due, on every chip
+    static void     tick(void);
+
+protected:
+    /**
+     * Does the chip answer to this address?  (the PCA9685 has several)
+     * @param address
+     * @return true if it does
+     */
+    virtual bool     match(uint8_t address)         { return address == _address; };
+    /**
+     * START (or repeated START) addressed to this chip
+     * @param read  R/W bit
+     */
+    virtual void     begin(bool read)               { };
+    /**
+     * A data byte from the master
+     * @param data
+     * @param index 0 for the first byte after the address
+     */
+    virtual void     writeByte(uint8_t data, uint8_t index) = 0;
+    /**
+     * A data byte to the master
+     * @return the byte
+     */
+    virtual uint8_t  readByte(void) = 0;
+    /**
+     * STOP or repeated START
+     */
+    virtual void     end(void)                      { };
+    /**
+     * The inputs (or stuck bits) changed
+     */
+    virtual void     update(void)                   { };
+
+    /**
+     * Override pin levels with the stuck bits
+     * @param levels
+     * @return levels with stuck bits applied
+     */
+    uint32_t applyStuck(uint32_t levels)            { return (levels & ~_stuckMask) | (_stuckValue & _stuckMask); };
+
+    uint8_t  _address;      ///< 7-bit I2C address
+    uint32_t _input;        ///< external pin levels
+    uint8_t  _index;        ///< data byte count in the current transaction
+
+private:
+    /// Is the path from the master to this chip open?
+    bool     routed(void);
+    SimTCA9548A *_mux;
+    uint8_t  _channel;
+    uint32_t _stuckMask;
+    uint32_t _stuckValue;
+    bool     _absent;
+    uint16_t _nackCount;
+    int16_t  _nackData;
+    uint32_t _reads;
+    uint32_t _writes;
+
+    const SimInput *_script;
+    uint16_t _steps;
+    uint16_t _step;
+    bool     _repeat;
+    uint64_t _origin;       ///< simNanos() when the script (or its current repeat) started
+
+    SimChip *_next;
+    static SimChip *_first;
+};
+
+/**
+ * PCF8574 / PCF8574A: 8 quasi-bidirectional pins, no registers.
+ * A pin written HIGH is a weak pullup that the outside world can pull LOW.
+ */
+class SimPCF8574 : public SimChip {
+public:
+    SimPCF8574(uint8_t address) : SimChip(address), _latch(0xFF) { _input = 0xFF; };
+    uint32_t pins(void)                             { return applyStuck(_latch & _input) & 0xFF; };
+    uint8_t  latch(void)                            { return _latch; };    ///< last byte written
+protected:
+    void     writeByte(uint8_t data, uint8_t index) { _latch = data; };
+    uint8_t  readByte(void)                         { return pins(); };
+    uint8_t  _latch;
+};
+
+/**
+ * PCA9555 (and the register compatible MCP23016):
+ * INPUT, OUTPUT, POLARITY and CONFIG register pairs.  The pointer toggles
+ * between the two registers of a pair on each byte.
+ */
+class SimPCA9555 : public SimChip {
+public:
+    SimPCA9555(uint8_t address);
+    uint32_t pins(void);
+    uint8_t  reg(uint8_t r)                         { return _reg[r & 0x07]; };   ///< register contents
+protected:
+    void     writeByte(uint8_t data, uint8_t index);
+    uint8_t  readByte(void);
+    /// register that the chip stores a write to
+    virtual uint8_t writable(uint8_t r)             { return (r < 2) ? 0xFF : r; };
+    uint8_t  _reg[8];
+    uint8_t  _ptr;
+};
+
+/**
+ * MCP23016: PCA9555 layout for GP/OLAT/IPOL/IODIR; writes to GP go to OLAT.
+ */
+class SimMCP23016 : public SimPCA9555 {
+public:
+    SimMCP23016(uint8_t address) : SimPCA9555(address) { };
+protected:
+    uint8_t  writable(uint8_t r)                    { return (r < 2) ? r + 2 : r; };
+};
+
+/**
+ * MAX7313: PCA9555 layout plus blink phase 1, master intensity,
+ * configuration and per-pin intensity registers.  (A MAX7311/7312 is the
+ * PCA9555 layout alone.)
+ */
+class SimMAX731x : public SimChip {
+public:
+    SimMAX731x(uint8_t address);
+    uint32_t pins(void);
+    uint8_t  reg(uint8_t r)                         { return _reg[r & 0x1F]; };   ///< register contents
+    /*!
+        @brief  PWM intensity of an output pin, as programmed
+        @param    pin
+        @return [0..15] sixteenths of the master intensity, 15 when intensity control is off
+    */
+    uint8_t  intensity(uint8_t pin);
+protected:
+    void     writeByte(uint8_t data, uint8_t index);
+    uint8_t  readByte(void);
+    void     step(void);
+    uint8_t  _reg[0x18];
+    uint8_t  _ptr;
+};
+
+/**
+ * MCP23017 in its power-on IOCON.BANK=0 layout: 22 registers, A/B interleaved,
+ * sequential addressing unless IOCON.SEQOP.  Interrupt-on-change with INTF/INTCAP,
+ * and an optional INT output wired to a simulated Arduino pin.
+ */
+class SimMCP23017 : public SimChip {
+public:
+    SimMCP23017(uint8_t address);
+    uint32_t pins(void);
+    uint8_t  reg(uint8_t r)                         { return _reg[r % 0x16]; };   ///< register contents
+    /*!
+        @brief  Wire the INT output (INTA, or both when IOCON.MIRROR) to an Arduino pin
+        @param    pin
+                  simulated Arduino pin
+    */
+    void     intPin(uint8_t pin)                    { _intPin = pin; signal(); };
+protected:
+    void     writeByte(uint8_t data, uint8_t index);
+    uint8_t  readByte(void);
+    void     update(void);
+    /// drive the INT pin from INTF
+    void     signal(void);
+    uint16_t pair(uint8_t r)                        { return _reg[r] | (_reg[r + 1] << 8); };
+    uint8_t  _reg[0x16];
+    uint8_t  _ptr;
+    uint16_t _prev;         ///< input levels at the last update(), for interrupt-on-change
+    int16_t  _intPin;
+};
+
+/**
+ * PCF8591: control byte, then D/A data.  Reads return the previous conversion
+ * first, then convert the selected channel (auto-incrementing if asked to).
+ */
+class SimPCF8591 : public SimChip {
+public:
+    SimPCF8591(uint8_t address) : SimChip(address), _control(0), _dac(0), _result(0x80), _channel(0) { _input = 0; };
+    uint8_t  dac(void)                              { return (_control & 0x40) ? _dac : 0; };   ///< D/A output, 0 when disabled
+    uint8_t  control(void)                          { return _control; };  ///< last control byte
+    /*!
+        @brief  Conversion of one A/D input
+        @param    channel
+        @return 8-bit value
+    */
+    uint8_t  analog(uint8_t channel)                { return (pins() >> (8 * (channel & 0x03))) & 0xFF; };
+protected:
+    void     writeByte(uint8_t data, uint8_t index);
+    uint8_t  readByte(void);
+    uint8_t  _control;
+    uint8_t  _dac;
+    uint8_t  _result;       ///< last conversion, sent first on the next read
+    uint8_t  _channel;
+};
+
+/**
+ * PCA9685: MODE1/MODE2, sub-addresses, ALLCALL, 16 LED ON/OFF register sets,
+ * ALL_LED and PRE_SCALE, with MODE1.AI auto-increment.  ACKs its own address,
+ * ALLCALLADR and any enabled SUBADRx, so group writes reach every member.
+ */
+class SimPCA9685 : public SimChip {
+public:
+    SimPCA9685(uint8_t address);
+    uint8_t  reg(uint8_t r)                         { return _reg[r]; };   ///< register contents
+    /*!
+        @brief  Duty cycle of a channel, as programmed
+        @param    channel
+        @return [0..4096] counts of 4096 the output is on
+    */
+    uint16_t duty(uint8_t channel);
+    /*!
+        @brief  Start and stop counts of a channel
+        @param    channel
+        @param    on    (output) ON count, with the FULL ON bit
+        @param    off   (output) OFF count, with the FULL OFF bit
+    */
+    void     led(uint8_t channel, uint16_t &on, uint16_t &off);
+protected:
+    bool     match(uint8_t address);
+    void     writeByte(uint8_t data, uint8_t index);
+    uint8_t  readByte(void);
+    void     step(void);
+    uint8_t  _reg[256];
+    uint8_t  _ptr;
+};
+
+/**
+ * TCA9548A / PCA9548: 8-channel I2C mux.  One control register, bit n connects channel n.
+ * Chips put behind() a channel only see the bus while it is connected.
+ */
+class SimTCA9548A : public SimChip {
+public:
+    SimTCA9548A(uint8_t address) : SimChip(address), _control(0), _selects(0) { };
+    uint8_t  control(void)                          { return _control; };  ///< connected channels
+    uint32_t selects(void)                          { return _selects; };  ///< control bytes received
+protected:
+    void     writeByte(uint8_t data, uint8_t index) { _control = data; _selects++; };
+    uint8_t  readByte(void)                         { return _control; };
+    uint8_t  _control;
+    uint32_t _selects;
+};
+
+#endif // SimChip_h
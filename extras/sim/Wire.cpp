@@ -0,0 +1,154 @@
+/*!
+   @file Wire.cpp
+
+   Host stand-in for the Arduino Wire library.
+
+   endTransmission() return codes are the same as the AVR library:
+    <pre>
+    0   success
+    1   data too long to fit in the transmit buffer
+    2   NACK on transmit of the address
+    3   NACK on transmit of data
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "Wire.h"
+#include "SimChip.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire() {
+    _txAddress  = 0;
+    _txLength   = 0;
+    _txOverflow = false;
+    _rxLength   = 0;
+    _rxIndex    = 0;
+    _held       = false;
+    _clock      = 100000;
+    _clocks     = 0;
+    resetStats();
+}
+
+void TwoWire::resetStats(void) {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void TwoWire::account(uint8_t bytes, uint8_t sendStop) {
+    SimBusStats before = _stats;
+    _stats.transactions++;
+    if (_held) _stats.restarts++;
+    else       _stats.starts++;
+    if (sendStop) _stats.stops++;
+    _stats.addrBytes++;
+    _stats.dataBytes += bytes;
+    _held = !sendStop;
+
+    uint32_t bits = _stats.bits() - before.bits();
+    simAdvance((uint32_t)(((uint64_t)bits * 1000000000UL) / _clock));
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    _txAddress  = address;
+    _txLength   = 0;
+    _txOverflow = false;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (_txLength >= BUFFER_LENGTH) {
+        _txOverflow = true;
+        return 0;
+    }
+    _txBuffer[_txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+    size_t n = 0;
+    while (quantity--) {
+        n += write(*data++);
+    }
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+    if (_txOverflow) {
+        _txOverflow = false;
+        return 1;
+    }
+    SimChip::tick();
+
+    // Every chip that answers to this address sees the write (ALLCALL, sub-addresses...)
+    bool    acked = false;
+    uint8_t sent  = 0;
+    uint8_t rc    = 0;
+    for (SimChip *c = SimChip::first(); c; c = c->next()) {
+        if (!c->attach(_txAddress, false)) {
+            continue;
+        }
+        acked = true;
+        uint8_t x;
+        for (x = 0; x < _txLength; x++) {
+            if (!c->receive(_txBuffer[x])) {
+                rc = 3;
+                x++;            // the NACKed byte was still clocked out
+                break;
+            }
+        }
+        if (x > sent) sent = x;
+        c->detach();
+    }
+    if (!acked) {
+        rc = 2;
+    }
+    if (rc) {
+        _stats.nacks++;
+    }
+    account(sent, sendStop);
+    return rc;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
+    if (quantity > BUFFER_LENGTH) {
+        quantity = BUFFER_LENGTH;
+    }
+    SimChip::tick();
+
+    _rxIndex  = 0;
+    _rxLength = 0;
+    for (SimChip *c = SimChip::first(); c; c = c->next()) {
+        if (c->attach(address, true)) {      // only one chip can drive SDA
+            for (_rxLength = 0; _rxLength < quantity; _rxLength++) {
+                _rxBuffer[_rxLength] = c->send();
+            }
+            c->detach();
+            break;
+        }
+    }
+    if (_rxLength == 0) {
+        _stats.nacks++;
+    }
+    account(_rxLength, sendStop);
+    return _rxLength;
+}
+
+int TwoWire::available(void) {
+    return _rxLength - _rxIndex;
+}
+
+int TwoWire::read(void) {
+    if (_rxIndex >= _rxLength) {
+        return -1;
+    }
+    return _rxBuffer[_rxIndex++];
+}
+
+int TwoWire::peek(void) {
+    if (_rxIndex >= _rxLength) {
+        return -1;
+    }
+    return _rxBuffer[_rxIndex];
+}
@@ -0,0 +1,130 @@
+/*!
+ * @file Wire.h
+ *
+ * Host stand-in for the Arduino Wire library, driving simulated I2C chips
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Same API and buffer limits as the AVR Wire library.  Every transaction is
+ *  delivered to the SimChip models that answer to its address, and counted:
+ *  START, repeated START and STOP conditions, address and data bytes.  Each
+ *  transaction also moves simulated time forward by its wire time at the
+ *  current setClock() speed.
+ */
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32
+#endif
+
+/**
+ * What went over the bus
+ */
+struct SimBusStats {
+    uint32_t transactions;  ///< address phases (endTransmission() and requestFrom() calls)
+    uint32_t starts;        ///< START conditions
+    uint32_t restarts;      ///< repeated START conditions
+    uint32_t stops;         ///< STOP conditions
+    uint32_t addrBytes;     ///< address bytes, including NACKed ones
+    uint32_t dataBytes;     ///< data bytes, in either direction
+    uint32_t nacks;         ///< transactions that were NACKed
+
+    /**
+     * SCL clocks on the wire, counting each START/Sr/STOP as one clock
+     * @return bit times
+     */
+    uint32_t bits(void) const       { return starts + restarts + stops + 9 * (addrBytes + dataBytes); };
+    /**
+     * Wire time at a given bus speed
+     * @param hz bus clock
+     * @return microseconds
+     */
+    uint32_t micros(uint32_t hz) const { return (uint32_t)(((uint64_t)bits() * 1000000UL + hz / 2) / hz); };
+};
+
+class TwoWire {
+public:
+    TwoWire(void);
+
+    void    begin(void)                                 { };
+    void    begin(uint8_t address)                      { };
+    void    end(void)                                   { };
+    void    setClock(uint32_t hz)                       { _clock = hz; _clocks++; };
+
+    void    beginTransmission(uint8_t address);
+    void    beginTransmission(int address)              { beginTransmission((uint8_t)address); };
+    uint8_t endTransmission(uint8_t sendStop);
+    uint8_t endTransmission(void)                       { return endTransmission((uint8_t)true); };
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, quantity, (uint8_t)true); };
+    uint8_t requestFrom(int address, int quantity)      { return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)true); };
+    uint8_t requestFrom(int address, int quantity, int sendStop) { return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop); };
+
+    size_t  write(uint8_t data);
+    size_t  write(const uint8_t *data, size_t quantity);
+    size_t  write(int data)                             { return write((uint8_t)data); };
+    size_t  write(unsigned int data)                    { return write((uint8_t)data); };
+    size_t  write(long data)                            { return write((uint8_t)data); };
+    size_t  write(unsigned long data)                   { return write((uint8_t)data); };
+    int     available(void);
+    int     read(void);
+    int     peek(void);
+    void    flush(void)                                 { };
+
+    /*
+    ***************************************************************************
+    **                        Simulation controls                            **
+    ***************************************************************************
+     */
+
+    /**
+     * Bus traffic since the last resetStats()
+     * @return counters
+     */
+    const SimBusStats &stats(void)                      { return _stats; };
+    /**
+     * Zero the traffic counters
+     */
+    void    resetStats(void);
+    /**
+     * The current setClock() speed
+     * @return Hz
+     */
+    uint32_t clock(void)                                { return _clock; };
+    /**
+     * How many times setClock() has been called
+     * @return count
+     */
+    uint32_t clockChanges(void)                         { return _clocks; };
+
+private:
+    uint8_t     _txAddress;
+    uint8_t     _txBuffer[BUFFER_LENGTH];
+    uint8_t     _txLength;
+    bool        _txOverflow;
+    uint8_t     _rxBuffer[BUFFER_LENGTH];
+    uint8_t     _rxLength;
+    uint8_t     _rxIndex;
+    bool        _held;          ///< last transaction ended without a STOP
+    uint32_t    _clock;
+    uint32_t    _clocks;
+    SimBusStats _stats;
+
+    /**
+     * Account for an address phase and its condition bits, and advance simulated time
+     * @param bytes     data bytes that followed the address
+     * @param sendStop  was it ended with a STOP?
+     */
+    void    account(uint8_t bytes, uint8_t sendStop);
+};
+
+extern TwoWire Wire;
+
+#endif // TwoWire_h
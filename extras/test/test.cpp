@@ -0,0 +1,810 @@
+/*!
+   @file test.cpp
+
+   Behaviour tests for I2Cexpander, run on the host simulator (extras/sim).
+
+   Where the bench measures what goes over the wire, these check that the
+   library does the right thing: changes are noticed and reported, callbacks
+   fire, filters take as long as they should, dead devices are quarantined
+   and come back, and motion gets where it is going.
+
+    <pre>
+    test                        run every test, exit status 1 if any check fails
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cexpander.h"
+#include "I2Cchip.h"
+#include "I2Cdebounce.h"
+#include "I2Cmotion.h"
+#include "I2Cadda.h"
+#include "I2Cblink.h"
+#include "ExpanderBus.h"
+#include "I2Cdiscover.h"
+#include "SimChip.h"
+#include <stdio.h>
+
+SimPCA9555  inputs (0x20);
+SimPCF8574  lamps  (0x21);
+SimPCA9555  signals(0x23);
+SimPCA9685  servos (0x40);
+SimPCA9685  lights (0x42);
+SimTCA9548A mux1   (0x71);
+SimTCA9548A mux2   (0x72);
+SimPCF8574  left   (0x24);      // the same address on two muxes
+SimPCF8574  right  (0x24);
+SimPCA9685  servosA(0x41);      // whole-chip drivers, each pair at one address on two muxes
+SimPCA9685  servosB(0x41);
+SimPCF8591  adcA   (0x48);
+SimPCF8591  adcB   (0x48);
+SimMAX731x  blinkA (0x50);
+SimMAX731x  blinkB (0x50);
+SimMCP23017 fast   (0x27);      // a Fast-mode Plus part
+SimMAX731x  dimmer (0x12);      // MAX731x #2
+
+static int checks   = 0;
+static int failures = 0;
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+    checks++;
+    if (!ok) {
+        printf("FAIL  line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+/*
+***************************************************************************
+**                        ExpanderBus                                    **
+***************************************************************************
+ */
+
+struct Seen {
+    uint8_t calls;
+    uint8_t index;
+    uint8_t bit;
+    bool    level;
+};
+
+static void seen(void *context, uint8_t index, uint8_t bit, bool level) {
+    Seen *s = (Seen *)context;
+    s->calls++;
+    s->index = index;
+    s->bit   = bit;
+    s->level = level;
+}
+
+// An input flip shows up in changed(), the change bitmap and the image
+static void testChanged(void) {
+    I2Cexpander m[2];
+    m[0].init(0, I2Cexpander::PCA9555, 0xFFFF);
+    m[1].init(1, I2Cexpander::PCF8574, 0x00FF);
+    ExpanderBus bus(m, 2);
+    inputs.input(0x0000);
+    lamps.input(0xFF);
+    bus.scan();
+    bus.scan();
+    CHECK(!bus.changed());
+    CHECK(bus.changedMap()[0] == 0);
+
+    inputs.input(0x0100);
+    CHECK(bus.scan() == 1);
+    CHECK(bus.changed());
+    CHECK(bus.changed(0));
+    CHECK(!bus.changed(1));
+    CHECK(bus.changedMap()[0] == 0x01);
+    CHECK(m[0].toggled() == 0x0100);
+    CHECK(m[0].rising() == 0x0100);
+    CHECK(bitRead(bus.image()[0], bus.bitOffset(0) + 8));
+
+    CHECK(bus.scan() == 0);
+    CHECK(bus.changedMap()[0] == 0);
+}
+
+// watch() callbacks fire once per changed watched bit, and not for the others
+static void testWatch(void) {
+    I2Cexpander m[1];
+    m[0].init(0, I2Cexpander::PCA9555, 0xFFFF);
+    ExpanderBus bus(m, 1);
+    Seen s = { 0, 0, 0, false };
+    CHECK(bus.watch(0, 0x00F0, seen, &s));
+    inputs.input(0x0000);
+    bus.scan();
+    s.calls = 0;
+
+    inputs.input(0x0020);
+    bus.scan();
+    CHECK(s.calls == 1);
+    CHECK((s.index == 0) && (s.bit == 5) && s.level);
+
+    inputs.input(0x0001);               // bit 5 falls, bit 0 (unwatched) rises
+    bus.scan();
+    CHECK(s.calls == 2);
+    CHECK((s.bit == 5) && !s.level);
+
+    bus.scan();                         // nothing changed
+    CHECK(s.calls == 2);
+}
+
+/*
+***************************************************************************
+**                        Deferred writes and cached reads               **
+***************************************************************************
+ */
+
+// With DEFER_WRITES, any number of digitalWrite()s go out as one write at commit()
+static void testDeferWrites(void) {
+    I2Cexpander m;
+    m.init(1, I2Cexpander::PCF8574, 0x00);      // 8 outputs
+    m.put(0x00);
+    m.policy(I2Cexpander::DEFER_WRITES);
+    Wire.resetStats();
+    for (uint8_t bit = 0; bit < 4; bit++) {
+        m.digitalWrite(bit, HIGH);
+    }
+    m.digitalWrite(6, HIGH);
+    CHECK(Wire.stats().transactions == 0);
+    CHECK(m.dirty());
+    CHECK(lamps.latch() == 0x00);
+
+    CHECK(m.commit());
+    CHECK(Wire.stats().transactions == 1);
+    CHECK(lamps.latch() == 0x4F);
+    CHECK(!m.dirty());
+    CHECK(!m.commit());                         // nothing new
+    CHECK(Wire.stats().transactions == 1);
+
+    m.policy(I2Cexpander::ELIDE_NONE);          // back to writing straight through
+    m.digitalWrite(7, HIGH);
+    CHECK(Wire.stats().transactions == 2);
+    CHECK(lamps.latch() == 0xCF);
+}
+
+// With CACHE_READS, a device is read once per epoch however many pins are looked at
+static void testCacheReads(void) {
+    I2Cexpander m;
+    m.init(0, I2Cexpander::PCA9555, 0xFFFF);
+    m.policy(I2Cexpander::CACHE_READS);
+    inputs.input(0x8001);
+    I2Cexpander::refresh();
+    Wire.resetStats();
+    uint16_t seen = 0;
+    for (uint8_t bit = 0; bit < 16; bit++) {
+        bitWrite(seen, bit, m.digitalRead(bit));
+    }
+    CHECK(seen == 0x8001);
+    uint32_t once = Wire.stats().transactions;
+    CHECK(once > 0);
+
+    inputs.input(0x0002);
+    CHECK(m.digitalRead(1) == 0);               // the cached answer, until the next epoch
+    CHECK(Wire.stats().transactions == once);
+    I2Cexpander::refresh();
+    CHECK(m.digitalRead(1) == 1);
+    CHECK(Wire.stats().transactions == 2 * once);
+
+    // freshness() starts a new epoch by itself
+    I2Cexpander::freshness(5000);
+    inputs.input(0x0004);
+    CHECK(m.digitalRead(2) == 0);
+    delay(5);
+    CHECK(m.digitalRead(2) == 1);
+    I2Cexpander::freshness(0);
+
+    m.policy(I2Cexpander::ELIDE_NONE);          // every digitalRead() goes to the device
+    Wire.resetStats();
+    m.digitalRead(0);
+    m.digitalRead(1);
+    CHECK(Wire.stats().transactions == 2 * once);
+}
+
+/*
+***************************************************************************
+**                        Non-blocking reads                             **
+***************************************************************************
+ */
+
+// beginRead()/poll() take at most one transaction per step, and leave the data where read() would
+static void testPoll(void) {
+    I2Cexpander a, b;
+    a.init(0, I2Cexpander::PCA9555, 0xFFFF);
+    b.init(I2Cexpander::muxed(1, 0, 0x24), I2Cexpander::PCF8574, 0xFF);
+    inputs.input(0x0000);
+    left.input(0x00);
+    a.read();
+    b.read();
+    I2Cexpander::muxReset();            // so that b starts with a mux select
+    inputs.input(0x1234);
+    left.input(0x5A);
+
+    Wire.resetStats();
+    a.beginRead();
+    b.beginRead();
+    CHECK(Wire.stats().transactions == 0);
+    uint8_t polls = 0;
+    while (!(a.done() && b.done()) && (polls < 10)) {
+        uint32_t before = Wire.stats().transactions;
+        a.poll();
+        CHECK(Wire.stats().transactions - before <= 1);
+        before = Wire.stats().transactions;
+        b.poll();
+        CHECK(Wire.stats().transactions - before <= 1);
+        polls++;
+    }
+    CHECK(polls == 2);                  // pointer write + fetch, mux select + fetch
+    CHECK(Wire.stats().transactions == 4);
+    CHECK(a.current() == 0x1234);
+    CHECK(a.toggled() == 0x1234);
+    CHECK(b.current() == 0x5A);
+    CHECK(a.ok() && b.ok());
+
+    // a device that doesn't answer keeps its last data, and reports no change
+    inputs.nack(true);
+    a.beginRead();
+    polls = 0;
+    while (!a.poll() && (polls < 10)) {
+        polls++;
+    }
+    inputs.nack(false);
+    CHECK(!a.ok());
+    CHECK(a.current() == 0x1234);
+    CHECK(a.toggled() == 0);
+}
+
+/*
+***************************************************************************
+**                        Debounce                                       **
+***************************************************************************
+ */
+
+// A change is reported on exactly the depth'th read that sees it
+static void testDebounce(void) {
+    for (uint8_t depth = 1; depth <= I2Cdebounce::MAXDEPTH; depth++) {
+        I2Cexpander m;
+        I2Cdebounce filter;
+        filter.depth(depth);
+        m.init(0, I2Cexpander::PCA9555, 0xFFFF);
+        m.debounce(&filter);
+        inputs.input(0x0000);
+        m.read();
+
+        inputs.input(0x0004);
+        uint8_t reads = 0;
+        while ((reads < 2 * I2Cdebounce::MAXDEPTH) && !(m.read() & 0x0004)) {
+            reads++;
+        }
+        CHECK(reads + 1 == depth);
+
+        // a one-sample glitch never gets through
+        inputs.input(0x0000);
+        m.read();
+        inputs.input(0x0004);
+        for (uint8_t x = 0; x < depth; x++) {
+            m.read();
+        }
+        CHECK((depth == 1) || (m.current() & 0x0004));
+    }
+}
+
+/*
+***************************************************************************
+**                        Error handling                                 **
+***************************************************************************
+ */
+
+// Repeated failures quarantine a device; it is re-probed, restored and rewritten when it answers again
+static void testQuarantine(void) {
+    I2Cexpander::retryPolicy(1, 4, 1000);
+    I2Cexpander m;
+    m.init(3, I2Cexpander::PCA9555, 0x0000);
+    m.write(0x1234);
+    CHECK(m.ok());
+    CHECK(m.health() == I2Cexpander::HEALTHY);
+
+    signals.nack(true);
+    m.write(0x4321);
+    CHECK(!m.ok());
+    CHECK(m.health() == I2Cexpander::DEGRADED);
+    for (uint8_t x = 0; x < 4; x++) {
+        m.write(0x4321);
+    }
+    CHECK(m.health() == I2Cexpander::QUARANTINED);
+
+    // while quarantined, nothing but an occasional probe goes on the bus
+    Wire.resetStats();
+    m.write(0x4321);
+    m.read();
+    CHECK(m.status() == I2Cexpander::STATUS_QUARANTINED);
+    CHECK(Wire.stats().addrBytes == 0);
+
+    signals.nack(false);
+    m.read();
+    CHECK(m.health() == I2Cexpander::QUARANTINED);      // not yet time to re-probe
+    delay(1000);
+    m.read();
+    CHECK(m.health() == I2Cexpander::HEALTHY);
+    CHECK(m.ok());
+    CHECK(signals.reg(I2Cexpander::PCA9555_OUTPUT) == 0x21);    // the write it missed
+    CHECK(signals.reg(I2Cexpander::PCA9555_OUTPUT + 1) == 0x43);
+}
+
+// A chip's init() sequence reports its first failure, not just its last transaction's
+static void testInitStatus(void) {
+    fast.nackNext(1);                   // the IODIR write
+    CHECK(I2Cchip::MCP23017::init(0x27, 0x00FF) == I2Cexpander::STATUS_ADDR_NACK);
+    CHECK(fast.reg(I2Cexpander::MCP23017_GPPUA) == 0xFF);     // the rest still went out
+    CHECK(I2Cchip::MCP23017::init(0x27, 0xFFFF) == I2Cexpander::STATUS_OK);
+    CHECK(fast.reg(I2Cexpander::MCP23017_IODIRB) == 0xFF);
+}
+
+/*
+***************************************************************************
+**                        Motion                                         **
+***************************************************************************
+ */
+
+// Channels get to their targets, within the time the profile allows, on a budget
+static void testMotion(void) {
+    I2Cpwm    board;
+    I2Cmotion motion;
+    board.init(0);
+    board.flush();
+    uint8_t a = motion.add(board, 0, 1000);
+    uint8_t b = motion.add(board, 1, 3000);
+    motion.budget(16);
+    motion.moveTo(a, 3000, 1000);           // 2 seconds at 1000 counts/s
+    motion.moveTo(b, 100, 2000, 4000);      // trapezoidal, with a reversal of direction
+    motion.moveTo(b, 4095, 2000, 4000);
+
+    uint32_t start = micros();
+    while (motion.moving() && (micros() - start < 10000000UL)) {
+        delay(10);
+        motion.update();
+    }
+    CHECK(!motion.moving());
+    CHECK(motion.position(a) == 3000);
+    CHECK(motion.written(a) == 3000);
+    CHECK(servos.duty(0) == 3000);
+    CHECK(motion.position(b) == 4095);
+    CHECK(servos.duty(1) == 4095);
+    CHECK(micros() - start >= 2000000UL);
+    CHECK(micros() - start <  2200000UL);
+}
+
+// A board that stops answering is tried once per update(), not once per axis; its axes catch up when it is back
+static void testMotionNack(void) {
+    I2Cpwm    board;
+    I2Cmotion motion;
+    board.init(0);
+    board.flush();
+    uint8_t axis[3];
+    for (uint8_t x = 0; x < 3; x++) {
+        axis[x] = motion.add(board, 8 + x, 1000);
+        motion.moveTo(axis[x], 1500, 0);    // jump
+    }
+    delay(10);
+    servos.nack(true);
+    Wire.resetStats();
+    motion.update();
+    CHECK(Wire.stats().transactions == 1);
+    CHECK(Wire.stats().nacks == 1);
+    CHECK(motion.written(axis[0]) == 1000);
+
+    servos.nack(false);
+    delay(10);
+    motion.update();
+    for (uint8_t x = 0; x < 3; x++) {
+        CHECK(motion.written(axis[x]) == 1500);
+        CHECK(servos.duty(8 + x) == 1500);
+    }
+}
+
+// I2Cexpander reads a PCA9685 channel back as its duty cycle, whether or not the OFF count wraps
+static void testPwmRead(void) {
+    static const uint16_t on[]  = {    0, 1000, 4000, 2048,  300 };
+    static const uint16_t off[] = { 1500, 3000,  100, 2048, 4095 };
+    I2Cpwm      board;
+    I2Cexpander m;
+    board.init(0);
+    m.init(0, I2Cexpander::PCA9685, 6);
+    for (uint8_t x = 0; x < sizeof(on) / sizeof(on[0]); x++) {
+        board.set(6, on[x], off[x]);
+        board.flush();
+        CHECK(m.read() == servos.duty(6));
+    }
+    CHECK(servos.duty(6) == 3795);
+    board.set(6, 4000, 100);
+    board.flush();
+    CHECK(m.read() == 196);
+}
+
+/*
+***************************************************************************
+**                        A/D and D/A                                    **
+***************************************************************************
+ */
+
+// I2Cadda oversamples in one request, keeps a ring of results, and keeps them when a transfer fails
+static void testSampling(void) {
+    I2Cadda adc;
+    adc.init(I2Cexpander::muxed(1, 3, 0x48));
+    adc.oversample(2);
+    adcA.input(0x80604020);
+    adc.sample(0);                              // opens the mux channel
+
+    Wire.resetStats();
+    CHECK(adc.sample(0) == 0x20 << 2);          // 16 conversions, 10 bits
+    CHECK(Wire.stats().transactions == 2);      // control byte, then one read
+    CHECK(adc.ok());
+
+    adc.sampleAll();
+    for (uint8_t c = 0; c < I2Cadda::CHANNELS; c++) {
+        CHECK(adc.value(c) == (0x20 * (c + 1)) << 2);
+    }
+
+    adcA.input(0x00000040);
+    adc.sample(0);
+    CHECK(adc.history(0, 0) == 0x40 << 2);
+    CHECK(adc.history(0, 1) == 0x20 << 2);
+    CHECK(adc.average(0) == ((0x20 * 3 + 0x40) << 2) / 4);  // four results so far
+    CHECK(adc.average(1) == 0x40 << 2);                     // just the one from sampleAll()
+
+    adcA.nack(true);
+    CHECK(adc.sample(0) == 0x40 << 2);          // the previous result
+    CHECK(!adc.ok());
+    adcA.nack(false);
+    CHECK(adc.history(0, 1) == 0x20 << 2);      // nothing was stored
+}
+
+static uint8_t ramp(uint16_t index) {
+    return index & 0xFF;
+}
+
+// stream() sends (Wire buffer - 1) samples per transaction, and dacOff() turns the output off
+static void testStream(void) {
+    static uint8_t wave[100];
+    for (uint8_t x = 0; x < sizeof(wave); x++) {
+        wave[x] = 0xFF - x;
+    }
+    I2Cadda adc;
+    adc.init(I2Cexpander::muxed(1, 3, 0x48));
+    adc.dac(0x10);                              // opens the mux channel
+    CHECK(adcA.dac() == 0x10);
+
+    Wire.resetStats();
+    adc.stream(wave, sizeof(wave));
+    CHECK(adc.ok());
+    CHECK(Wire.stats().transactions == (sizeof(wave) + I2C_EXPANDER_BUFFER - 2) / (I2C_EXPANDER_BUFFER - 1));
+    CHECK(Wire.stats().dataBytes == sizeof(wave) + Wire.stats().transactions);    // a control byte each
+    CHECK(adcA.dac() == wave[sizeof(wave) - 1]);
+
+    adc.stream(ramp, 300);
+    CHECK(adcA.dac() == (299 & 0xFF));
+
+    adc.dacOff();
+    CHECK(adcA.dac() == 0);
+    CHECK(adc.ok());
+
+    adcA.nack(true);
+    adc.dac(0x33);
+    CHECK(!adc.ok());
+    adcA.nack(false);
+    adc.dac(0x33);
+    CHECK(adc.ok() && (adcA.dac() == 0x33));
+}
+
+/*
+***************************************************************************
+**                        Blink and intensity                            **
+***************************************************************************
+ */
+
+// I2Cblink writes only what changed, flips phases in one 2-byte write, and keeps a failed write's state
+static void testBlink(void) {
+    I2Cexpander m;
+    I2Cblink    b;
+    m.init(2, I2Cexpander::MAX731x, 0x0000);    // MAX7313 #2, 16 outputs
+    m.write(0xFFFF);
+    b.init(2);
+    b.phase1(0x00FF);
+    b.master(15);
+    b.intensity(3, 4);
+    b.blink(true);
+    b.flush();
+    CHECK(b.ok() && !b.dirty());
+    CHECK(dimmer.reg(I2Cexpander::MAX731x_PHASE1 + 1) == 0x00);
+    CHECK(dimmer.intensity(3) == 4);
+    CHECK(dimmer.intensity(4) == 15);
+    CHECK(dimmer.pins() == 0xFFFF);             // phase 0 showing
+
+    Wire.resetStats();
+    CHECK(b.flush() == 0);                      // nothing changed
+    CHECK(Wire.stats().transactions == 0);
+    b.flip();
+    CHECK(Wire.stats().transactions == 1);
+    CHECK(Wire.stats().dataBytes == 2);
+    CHECK(dimmer.pins() == 0x00FF);             // phase 1
+
+    b.intensity(5, 9);
+    Wire.resetStats();
+    CHECK(b.flush() == 1);                      // just the one intensity register
+    CHECK(Wire.stats().dataBytes == 2);
+    CHECK(dimmer.intensity(5) == 9);
+
+    dimmer.nack(true);
+    b.flip();
+    b.phase1(0x0F0F);
+    b.flush();
+    CHECK(!b.ok() && b.dirty());
+    dimmer.nack(false);
+    CHECK(dimmer.pins() == 0x00FF);
+    b.flush();
+    CHECK(b.ok() && !b.dirty());
+    CHECK(dimmer.pins() == 0x0F0F);             // still phase 1: the failed flip() didn't count
+    b.flip();
+    CHECK(dimmer.pins() == 0xFFFF);
+}
+
+/*
+***************************************************************************
+**                        PWM groups                                     **
+***************************************************************************
+ */
+
+// One group write reaches every member, and only an ACKed one changes their shadows
+static void testGroup(void) {
+    I2Cpwm      a, b;
+    I2CpwmGroup group;
+    a.init(0);
+    b.init(2);
+    a.flush();
+    b.flush();
+    group.init(0x60);
+    CHECK(group.add(a) && group.add(b));
+    CHECK(servos.reg(I2Cexpander::PCA9685_SUBADR1) == 0x60 << 1);
+    CHECK(lights.reg(I2Cexpander::PCA9685_MODE1) & I2Cexpander::PCA9685_MODE1_SUBADR1);
+
+    Wire.resetStats();
+    group.set(2, 0x0300);
+    CHECK(group.ok());
+    CHECK(Wire.stats().transactions == 1);
+    CHECK((servos.duty(2) == 0x0300) && (lights.duty(2) == 0x0300));
+    CHECK((a.get(2) == 0x0300) && (b.get(2) == 0x0300));
+    CHECK(!a.dirty() && !b.dirty());
+
+    static const uint16_t ramp[] = { 0x0100, 0x0200, 0x0400 };
+    group.set(4, ramp, 3);
+    CHECK((servos.duty(6) == 0x0400) && (lights.duty(5) == 0x0200));
+
+    servos.nack(true);
+    lights.nack(true);
+    group.setAll(0x0FFF);
+    CHECK(!group.ok());
+    CHECK((a.get(2) == 0x0300) && (b.get(6) == 0x0400));    // the shadows still match the chips
+    servos.nack(false);
+    lights.nack(false);
+
+    group.allOff();
+    CHECK(group.ok());
+    CHECK((servos.duty(2) == 0) && (lights.duty(6) == 0));
+    CHECK(a.get(2) == b.get(2));
+
+    // the power-on ALLCALL address needs no setup
+    I2CpwmGroup all;
+    all.init(I2CpwmGroup::ALLCALL);
+    Wire.resetStats();
+    CHECK(all.add(a));
+    CHECK(Wire.stats().transactions == 0);
+}
+
+/*
+***************************************************************************
+**                        Muxes                                          **
+***************************************************************************
+ */
+
+// A group write to a mux's address must not leave its channels open
+static void testGroupMux(void) {
+    left.input(0x11);
+    right.input(0x22);
+    I2Cexpander m[2];
+    m[0].init(I2Cexpander::muxed(1, 0, 0x24), I2Cexpander::PCF8574, 0xFF);
+    m[1].init(I2Cexpander::muxed(2, 1, 0x24), I2Cexpander::PCF8574, 0xFF);
+    CHECK(m[0].read() == 0x11);
+
+    I2Cpwm      board;
+    I2CpwmGroup group;
+    board.init(0);
+    group.init(0x71);                   // shares mux1's address
+    CHECK(group.add(board));
+    group.set(0, 0x0100);               // the last data byte would open mux1 channel 0
+    CHECK(group.ok());
+    CHECK(servos.duty(0) == 0x0100);
+    CHECK(mux1.control() == 0);
+
+    CHECK(m[1].read() == 0x22);         // not left's 0x11
+    CHECK(mux1.control() == 0);
+    CHECK(m[0].read() == 0x11);
+    CHECK(mux2.control() == 0);
+}
+
+// I2Cpwm, I2Cadda and I2Cblink reach the chip behind the mux channel they were given
+static void testRouted(void) {
+    adcA.input(0x40);
+    adcB.input(0xC0);
+
+    I2Cpwm a, b;
+    a.init(I2Cexpander::muxed(1, 2, 0x41));
+    b.init(I2Cexpander::muxed(2, 2, 0x41));
+    CHECK(a.ok() && b.ok());
+    a.set(3, 0x0123);
+    b.set(3, 0x0456);
+    a.flush();
+    CHECK(mux1.control() == 0x04);
+    b.flush();
+    CHECK(mux1.control() == 0);         // closed before mux2 opens
+    CHECK(mux2.control() == 0x04);
+    CHECK(servosA.duty(3) == 0x0123);
+    CHECK(servosB.duty(3) == 0x0456);
+
+    I2Cadda c, d;
+    c.init(I2Cexpander::muxed(1, 3, 0x48));
+    d.init(I2Cexpander::muxed(2, 3, 0x48));
+    CHECK(c.sample(0) < d.sample(0));
+    CHECK(c.ok() && d.ok());
+    c.dac(0x55);
+    CHECK(adcA.dac() == 0x55);
+    CHECK(adcB.dac() == 0);
+
+    I2Cblink e, f;
+    e.init(I2Cexpander::muxed(1, 4, 0x50));
+    f.init(I2Cexpander::muxed(2, 4, 0x50));
+    e.phase1(0x1234);
+    e.flush();
+    f.phase1(0x4321);
+    f.flush();
+    CHECK(e.ok() && f.ok());
+    CHECK(blinkA.reg(I2Cexpander::MAX731x_PHASE1) == 0x34);
+    CHECK(blinkB.reg(I2Cexpander::MAX731x_PHASE1) == 0x21);
+
+    // a chip behind a mux can't take part in group writes
+    I2CpwmGroup group;
+    group.init(I2CpwmGroup::ALLCALL);
+    CHECK(!group.add(a));
+
+    // nothing is written past a mux that doesn't answer, and the channels stay dirty
+    a.set(3, 0x0789);
+    a.flush();                          // leaves mux1 selected
+    mux2.nack(true);
+    b.set(3, 0x0789);
+    CHECK(b.flush() == 0);
+    CHECK(!b.ok() && b.dirty());
+    mux2.nack(false);
+    b.flush();
+    CHECK(b.ok());
+    CHECK(servosB.duty(3) == 0x0789);
+}
+
+/*
+***************************************************************************
+**                        Bus speed                                      **
+***************************************************************************
+ */
+
+// After a 1MHz access, the whole-chip drivers drop the bus back within their chips' fmax
+static void testClock(void) {
+    I2Cexpander m;
+    m.init(7, I2Cexpander::MCP23017, 0xFFFF);
+    m.setClock(I2Cexpander::CLOCK_1M);
+    I2Cpwm      board;
+    I2Cadda     adc;
+    I2Cblink    blink;
+    I2CpwmGroup group;
+    board.init(0);
+    adc.init(I2Cexpander::muxed(1, 3, 0x48));
+    blink.init(I2Cexpander::muxed(1, 4, 0x50));
+    group.init(I2CpwmGroup::ALLCALL);
+    group.add(board);
+
+    m.read();
+    CHECK(Wire.clock() == I2Cexpander::CLOCK_1M);
+    adc.sample(1);
+    CHECK(adc.ok());
+    CHECK(Wire.clock() == I2Cexpander::CLOCK_400K);
+
+    m.read();
+    blink.flip();
+    CHECK(blink.ok());
+    CHECK(Wire.clock() == I2Cexpander::CLOCK_400K);
+
+    m.read();
+    board.set(5, 0x0200);
+    board.flush();
+    CHECK(board.ok());
+    CHECK(Wire.clock() == I2Cexpander::CLOCK_400K);
+
+    m.read();
+    group.setAll(0x0100);
+    CHECK(group.ok());
+    CHECK(Wire.clock() == I2Cexpander::CLOCK_400K);
+
+    // and the expander gets its own clock back
+    m.read();
+    CHECK(Wire.clock() == I2Cexpander::CLOCK_1M);
+}
+
+/*
+***************************************************************************
+**                        Discovery                                      **
+***************************************************************************
+ */
+
+// A table built from what sweep() prints passes check(), muxed devices and MAX731x indexes included
+static void testDiscover(void) {
+    static I2Cexpander m[I2CDISCOVER_MAX];
+    I2Cdiscover d;
+    uint8_t found = d.sweep();
+    CHECK(found == d.count());
+    CHECK(d.isMux(0x71) && d.isMux(0x72));
+
+    uint8_t n = 0;
+    bool    max731x = false;
+    bool    routed  = false;
+    for (uint8_t x = 0; x < d.count(); x++) {
+        if (d.alias(x)) {
+            continue;
+        }
+        CHECK(d.type(x) != I2Cexpander::IGNORE);
+        uint16_t config = (d.type(x) == I2Cexpander::PCF8574) ? 0x00FF :
+                          ((d.type(x) == I2Cexpander::PCA9685) || (d.type(x) == I2Cexpander::PCF8591)) ? 0x0000 : 0xFFFF;
+        m[n].init(d.initAddress(x), d.type(x), config);
+        CHECK(m[n].i2caddr() == d.address(x));
+        max731x |= (d.address(x) == 0x12) && (d.initAddress(x) == 2);
+        routed  |= (d.muxaddr(x) != 0);
+        n++;
+    }
+    CHECK(max731x);
+    CHECK(routed);
+    CHECK(d.check(m, n) == 0);
+    I2Cexpander::muxReset();
+}
+
+int main(void) {
+    Wire.begin();
+    left.behind(&mux1, 0);
+    right.behind(&mux2, 1);
+    servosA.behind(&mux1, 2);
+    servosB.behind(&mux2, 2);
+    adcA.behind(&mux1, 3);
+    adcB.behind(&mux2, 3);
+    blinkA.behind(&mux1, 4);
+    blinkB.behind(&mux2, 4);
+
+    testDiscover();
+    testChanged();
+    testWatch();
+    testDeferWrites();
+    testCacheReads();
+    testPoll();
+    testDebounce();
+    testQuarantine();
+    testInitStatus();
+    testMotion();
+    testMotionNack();
+    testPwmRead();
+    testSampling();
+    testStream();
+    testBlink();
+    testGroup();
+    testGroupMux();
+    testRouted();
+    testClock();
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
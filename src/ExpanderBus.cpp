@@ -0,0 +1,274 @@
+/*!
+   @file ExpanderBus.cpp
+
+   Bus-wide scan manager for a table of I2Cexpander devices.
+
+   A typical loop() reads every device, asks each one if it changed, and then
+   walks the layout objects that care.  ExpanderBus folds the first two steps
+   into a single scan() so that a layout with 100+ devices can check for
+   "nothing changed" with a single test:
+
+    <pre>
+    I2Cexpander m[NUMPORTS];
+    ExpanderBus bus(m, NUMPORTS);
+
+    loop() {
+        if (bus.scan()) {
+            for each device where bus.changed(x) is true, handle the side effects
+        }
+    }
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "ExpanderBus.h"
+
+ExpanderBus::ExpanderBus(I2Cexpander *devices, uint8_t count) {
+    _devices    = devices;
+    _count      = (count > EXPANDERBUS_MAXDEVICES) ? EXPANDERBUS_MAXDEVICES : count;
+    _nchanged   = 0;
+    _ordered    = false;
+    _reverse    = false;
+    _scanning   = false;
+    _nwatches   = 0;
+    _cursor     = 0;
+    _scanstart  = 0;
+    _scanmicros = 0;
+    memset(_changed, 0, sizeof(_changed));
+    memset(_image,   0, sizeof(_image));
+    _front      = 0;
+    _bits       = 0;
+}
+
+uint8_t ExpanderBus::scan(void) {
+    uint32_t start  = micros();
+
+    if (!_ordered) {
+        reorder();
+    }
+    I2Cexpander::refresh();
+    for (uint8_t x = 0; x < _count; x++) {
+        I2Cexpander &d = at(x);
+        if (d.getSize() != 0) {     // IGNOREd or uninitialized, nothing to read
+            d.read();
+        }
+    }
+    collect();
+    dispatch();
+    _reverse    = !_reverse;
+    _scanmicros = micros() - start;
+    return _nchanged;
+}
+
+void ExpanderBus::beginScan(void) {
+    if (!_ordered) {
+        reorder();
+    }
+    I2Cexpander::refresh();
+    _scanning  = true;
+    _cursor    = 0;
+    _scanstart = micros();
+    next();
+}
+
+bool ExpanderBus::poll(void) {
+    if (!_scanning) {
+        return true;
+    }
+    if (_cursor < _count) {
+        if (at(_cursor).poll()) {
+            _cursor++;
+            next();
+        }
+        if (_cursor < _count) {
+            return false;
+        }
+    }
+    collect();
+    dispatch();
+    _reverse    = !_reverse;
+    _scanning   = false;
+    _scanmicros = micros() - _scanstart;
+    return true;
+}
+
+uint8_t ExpanderBus::commit(void) {
+    uint8_t n = 0;
+
+    if (!_ordered) {
+        reorder();
+    }
+    for (uint8_t x = 0; x < _count; x++) {
+        if (at(x).commit()) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void ExpanderBus::next(void) {
+    while ((_cursor < _count) && (at(_cursor).getSize() == 0)) {
+        _cursor++;
+    }
+    if (_cursor < _count) {
+        at(_cursor).beginRead();
+    }
+}
+
+void ExpanderBus::collect(void) {
+    uint16_t offset = 0;
+
+    memset(_changed, 0, sizeof(_changed));
+    _nchanged = 0;
+    for (uint8_t x = 0; x < _count; x++) {
+        I2Cexpander &d = _devices[x];
+        uint8_t size = d.getSize();
+        if (size == 0) {
+            continue;
+        }
+        if (d.changed()) {
+            bitSet(_changed[x >> 5], x & 0x1F);
+            _nchanged++;
+        }
+        if (offset + size <= EXPANDERBUS_MAXBITS) {
+            putBits(offset, size, d.current());
+        }
+        offset += size;
+    }
+    _bits  = (offset > EXPANDERBUS_MAXBITS) ? EXPANDERBUS_MAXBITS : offset;
+    _front ^= 1;
+}
+
+// Host and 32-bit builds XOR 4 words at a time with the compiler's vector
+// extensions (SSE2/NEON where the target has it); an AVR does it a word at a time
+#if defined(__GNUC__) && !defined(__AVR__)
+typedef uint32_t Lanes __attribute__((vector_size(16)));
+#endif
+
+bool ExpanderBus::diff(uint32_t *delta) {
+    const uint32_t *a     = _image[_front];
+    const uint32_t *b     = _image[_front ^ 1];
+    uint16_t        words = (_bits + 31) / 32;
+    uint16_t        w     = 0;
+    uint32_t        any   = 0;
+
+#if defined(__GNUC__) && !defined(__AVR__)
+    Lanes acc = { 0, 0, 0, 0 };
+    for (; w + 4 <= words; w += 4) {
+        Lanes va, vb;
+        memcpy(&va, a + w, sizeof(va));
+        memcpy(&vb, b + w, sizeof(vb));
+        Lanes d = va ^ vb;
+        if (delta) {
+            memcpy(delta + w, &d, sizeof(d));
+        }
+        acc |= d;
+    }
+    any = acc[0] | acc[1] | acc[2] | acc[3];
+#endif
+    for (; w < words; w++) {
+        uint32_t d = a[w] ^ b[w];
+        if (delta) {
+            delta[w] = d;
+        }
+        any |= d;
+    }
+    return any != 0;
+}
+
+bool ExpanderBus::watch(uint8_t index, uint32_t mask, Callback callback, void *context) {
+    if ((_nwatches >= EXPANDERBUS_MAXWATCHES) || (index >= _count)) {
+        return false;
+    }
+    // keep the table sorted by device, so dispatch() can walk it alongside the change map
+    uint8_t x = _nwatches++;
+    while ((x > 0) && (_watches[x - 1].index > index)) {
+        _watches[x] = _watches[x - 1];
+        x--;
+    }
+    _watches[x].index    = index;
+    _watches[x].mask     = mask;
+    _watches[x].callback = callback;
+    _watches[x].context  = context;
+    return true;
+}
+
+// Only changed devices are visited, and only their changed bits: both loops
+// step from one set bit to the next instead of testing every device and pin
+void ExpanderBus::dispatch(void) {
+    if ((_nwatches == 0) || (_nchanged == 0)) {
+        return;
+    }
+    uint8_t w = 0;
+    for (uint8_t word = 0; word < (_count + 31) / 32; word++) {
+        uint32_t devices = _changed[word];
+        while (devices) {
+            uint8_t index = (word << 5) + ctz(devices);
+            devices &= devices - 1;
+            while ((w < _nwatches) && (_watches[w].index < index)) {
+                w++;
+            }
+            if (w == _nwatches) {
+                return;
+            }
+            I2Cexpander &d       = _devices[index];
+            uint32_t     toggled = d.toggled();
+            for (uint8_t x = w; (x < _nwatches) && (_watches[x].index == index); x++) {
+                uint32_t bits = toggled & _watches[x].mask;
+                while (bits) {
+                    uint8_t bit = ctz(bits);
+                    bits &= bits - 1;
+                    _watches[x].callback(_watches[x].context, index, bit, bitRead(d.current(), bit));
+                }
+            }
+        }
+    }
+}
+
+// Sort key: clock, then mux route (direct devices, muxaddr() == 0, come first)
+static uint32_t route(I2Cexpander &d) {
+    return (d.getClock() << 8) | ((d.muxaddr() & 0x07) << 4) | ((d.muxaddr() != 0) << 3) | d.muxchannel();
+}
+
+// Stable insertion sort
+void ExpanderBus::reorder(void) {
+    for (uint8_t x = 0; x < _count; x++) {
+        uint8_t  index = x;
+        uint32_t key   = route(_devices[x]);
+        uint8_t  y     = x;
+        while (y > 0) {
+            if (route(_devices[_order[y - 1]]) <= key) {
+                break;
+            }
+            _order[y] = _order[y - 1];
+            y--;
+        }
+        _order[y] = index;
+    }
+    _ordered = true;
+}
+
+uint16_t ExpanderBus::bitOffset(uint8_t index) {
+    uint16_t offset = 0;
+    for (uint8_t x = 0; x < index && x < _count; x++) {
+        offset += _devices[x].getSize();
+    }
+    return offset;
+}
+
+void ExpanderBus::putBits(uint16_t offset, uint8_t size, uint32_t data) {
+    uint16_t w     = offset >> 5;
+    uint8_t  shift = offset & 0x1F;
+    uint64_t mask  = (size >= 32) ? 0xFFFFFFFFULL : ((1ULL << size) - 1);
+    uint64_t v     = ((uint64_t)data & mask) << shift;
+    mask <<= shift;
+
+    uint32_t *image = _image[_front ^ 1];
+    image[w] = (image[w] & ~(uint32_t)mask) | (uint32_t)v;
+    if (shift + size > 32) {    // straddles a word boundary
+        image[w + 1] = (image[w + 1] & ~(uint32_t)(mask >> 32)) | (uint32_t)(v >> 32);
+    }
+}
@@ -0,0 +1,294 @@
+/*!
+ * @file ExpanderBus.h
+ *
+ * Bus-wide scan manager for a table of I2Cexpander devices
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Instead of walking an array of expanders and calling read() and changed()
+ *  on each one, an ExpanderBus scans the whole table in one ordered pass and
+ *  hands back a per-device "changed" bitmap along with a packed image of all
+ *  the data that was read.
+ *
+ *  The image is double buffered: each scan fills the back buffer and then
+ *  swaps, so image() and previous() are the last two scans side by side and
+ *  "did anything on the layout change" is a word-wide XOR of the two.
+ *
+ *  Devices are read grouped by bus clock and by mux channel, so the clock is
+ *  switched and each channel selected once per scan instead of once per device.
+ *  Alternate scans run the order backwards, so the group the last scan ended
+ *  with is the one the next scan starts with.
+ *
+ *  beginScan()/poll() do the same scan one bus transaction at a time, so the
+ *  sketch can keep servicing serial traffic while it runs:
+ *
+ *  <pre>
+ *  loop() {
+ *      if (bus.done()) bus.beginScan();
+ *      if (bus.poll() && bus.changed()) { ... }
+ *      service LocoNet/CMRI ...
+ *  }
+ *  </pre>
+ */
+
+#ifndef ExpanderBus_h
+#define ExpanderBus_h
+
+#include "I2Cexpander.h"
+
+/**
+ * Capacity limits - these may be overridden with compiler flags.
+ * Small-RAM AVRs (Uno, Pro-Mini, Leonardo) get a smaller default table.
+ */
+#ifndef EXPANDERBUS_MAXDEVICES
+#if defined(RAMEND) && (RAMEND < 0x1000)
+#define EXPANDERBUS_MAXDEVICES  32      ///< Max number of devices in a bus table
+#else
+#define EXPANDERBUS_MAXDEVICES  128     ///< Max number of devices in a bus table
+#endif
+#endif
+
+#ifndef EXPANDERBUS_MAXWATCHES
+#if defined(RAMEND) && (RAMEND < 0x1000)
+#define EXPANDERBUS_MAXWATCHES  16      ///< Max number of watch() registrations
+#else
+#define EXPANDERBUS_MAXWATCHES  64      ///< Max number of watch() registrations
+#endif
+#endif
+
+#ifndef EXPANDERBUS_MAXBITS
+#define EXPANDERBUS_MAXBITS     (EXPANDERBUS_MAXDEVICES * 16)  ///< Size of the packed data image
+#endif
+
+/**
+ * Scan an array of I2Cexpanders as a unit:
+ *    scan()
+ *    changed() / changed(index)
+ *    image()
+ */
+class ExpanderBus {
+public:
+    /**
+     * Called for each watched input bit that changed in a scan
+     * @param context   the pointer given to watch(), usually the layout object
+     * @param index     position of the device in the table
+     * @param bit       which bit
+     * @param level     its new value
+     */
+    typedef void (*Callback)(void *context, uint8_t index, uint8_t bit, bool level);
+
+    /*!
+        @brief  ExpanderBus class Constructor.
+        @param    devices
+                  The device table - usually the same I2Cexpander m[NUMPORTS] array the sketch
+                  initializes in setup().  Devices are scanned grouped by clock, and within
+                  that, directly attached devices and then each mux channel's devices;
+                  within a group, in table order.
+        @param    count
+                  How many entries in the table (clamped to EXPANDERBUS_MAXDEVICES)
+    */
+    ExpanderBus(I2Cexpander *devices, uint8_t count);
+
+    /*!
+        @brief  Read every device in table order, noting which ones have changed inputs.
+        @return the number of devices whose inputs changed during this scan
+    */
+    uint8_t  scan(void);
+
+    /*!
+        @brief  Start a non-blocking scan().  Nothing goes on the bus until poll().
+    */
+    void     beginScan(void);
+
+    /*!
+        @brief  Run the next step of a scan started by beginScan() - at most one bus transaction.
+                When the last device has been read, changed(), changedMap() and image() are
+                updated just as scan() would have left them.
+        @return TRUE when the scan is done
+    */
+    bool     poll(void);
+
+    /*!
+        @brief  Is the scan started by beginScan() finished?
+        @return TRUE if no scan is in progress
+    */
+    bool     done(void)                     { return !_scanning; };
+
+    /*!
+        @brief  Write every device with a deferred write (see I2Cexpander::DEFER_WRITES and
+                I2Cexpander::commit()), grouped by clock and mux channel the same way scan() is.
+                Call once at the end of loop(), after the layout logic has set its outputs.
+        @return the number of devices written
+    */
+    uint8_t  commit(void);
+
+    /*!
+        @brief  Ask to be called when some of a device's input bits change.  At the end of every
+                scan, each watched bit in the device's toggled() mask gets a callback; devices
+                and bits that didn't change cost nothing.
+        @param    index
+                  position of the device in the table
+        @param    mask
+                  which bits
+        @param    callback
+        @param    context
+                  passed back to the callback
+        @return FALSE if EXPANDERBUS_MAXWATCHES registrations have already been made
+    */
+    bool     watch(uint8_t index, uint32_t mask, Callback callback, void *context = NULL);
+
+    /*!
+        @brief  Work out the scan order again.  The first scan() does this by itself;
+                call it if devices are re-init()'d onto a different mux channel or clock later.
+    */
+    void     reorder(void);
+
+    /*!
+        @brief  Did anything change during the last scan()?
+        @return TRUE if any device reported a change.
+    */
+    bool     changed(void)                  { return _nchanged != 0; };
+
+    /*!
+        @brief  Did a particular device change during the last scan()?
+        @param    index
+                  position of the device in the table
+        @return TRUE if the device reported a change.
+    */
+    bool     changed(uint8_t index)         { return bitRead(_changed[index >> 5], index & 0x1F); };
+
+    /*!
+        @brief  The per-device change bitmap - bit (index % 32) of word (index / 32)
+                is set if that device's inputs changed during the last scan().
+        @return pointer to (EXPANDERBUS_MAXDEVICES + 31) / 32 words
+    */
+    const uint32_t *changedMap(void)        { return _changed; };
+
+    /*!
+        @brief  The packed data image - each device's last read data, getSize() bits wide,
+                laid out in table order starting at bit 0 of word 0.  It stays put until
+                the scan after next, so it can be handed to other code without copying.
+        @return pointer to (EXPANDERBUS_MAXBITS + 31) / 32 words
+    */
+    const uint32_t *image(void)             { return _image[_front]; };
+
+    /*!
+        @brief  The packed data image from the scan before the last one
+        @return pointer to (EXPANDERBUS_MAXBITS + 31) / 32 words
+    */
+    const uint32_t *previous(void)          { return _image[_front ^ 1]; };
+
+    /*!
+        @brief  How much of the image is in use?
+        @return the total of every device's getSize(), in bits
+    */
+    uint16_t imageBits(void)                { return _bits; };
+
+    /*!
+        @brief  Compare image() with previous(), a word at a time.  Unlike changed(), this
+                includes output bits and analog values.
+        @param    delta
+                  if not NULL, gets image() XOR previous(), (imageBits() + 31) / 32 words
+        @return TRUE if any bit is different
+    */
+    bool     diff(uint32_t *delta = NULL);
+
+    /*!
+        @brief  Where does a device's data start in the image?
+        @param    index
+                  position of the device in the table
+        @return bit offset into image()
+    */
+    uint16_t bitOffset(uint8_t index);
+
+    /*!
+        @brief  How long did the last scan() take?
+        @return elapsed time in microseconds
+    */
+    uint32_t scanMicros(void)               { return _scanmicros; };
+
+    /*!
+        @brief  Number of devices managed by this bus
+        @return device count
+    */
+    uint8_t  count(void)                    { return _count; };
+
+    /*!
+        @brief  Access a device in the table
+        @param    index
+                  position of the device in the table
+        @return the device
+    */
+    I2Cexpander &device(uint8_t index)      { return _devices[index]; };
+
+private:
+    I2Cexpander *_devices;      ///< the device table
+    uint8_t      _count;        ///< number of entries in the device table
+    uint8_t      _nchanged;     ///< number of devices that changed in the last scan
+    bool         _ordered;      ///< has _order been worked out?
+    bool         _reverse;      ///< run _order backwards this scan
+    bool         _scanning;     ///< beginScan() in progress
+    uint8_t      _cursor;       ///< ...position in _order of the device being read
+    uint32_t     _scanstart;    ///< ...micros() at beginScan()
+    uint8_t      _order[EXPANDERBUS_MAXDEVICES];                 ///< table indexes, grouped by mux channel
+    uint32_t     _scanmicros;   ///< duration of the last scan
+    uint32_t     _changed[(EXPANDERBUS_MAXDEVICES + 31) / 32];   ///< per-device change bitmap
+
+    /** One watch() registration */
+    struct Watch {
+        uint32_t mask;
+        Callback callback;
+        void    *context;
+        uint8_t  index;
+    };
+    Watch        _watches[EXPANDERBUS_MAXWATCHES];  ///< sorted by device index
+    uint8_t      _nwatches;
+    uint32_t     _image[2][(EXPANDERBUS_MAXBITS + 31) / 32];     ///< packed data from all devices, front and back
+    uint8_t      _front;        ///< which _image is image()
+    uint16_t     _bits;         ///< bits of _image in use
+
+    /**
+     * The device at a position in this scan's order
+     * @param x     position
+     * @return the device
+     */
+    I2Cexpander &at(uint8_t x)              { return _devices[_order[_reverse ? (_count - 1 - x) : x]]; };
+    /**
+     * After every device has been read: the change map and packed image, in table order
+     */
+    void         collect(void);
+    /**
+     * Call the watch() callbacks for the bits that changed in this scan
+     */
+    void         dispatch(void);
+    /**
+     * Count trailing zeros
+     * @param v     non-zero
+     * @return index of the lowest set bit
+     */
+    static uint8_t ctz(uint32_t v) {
+#if defined(__GNUC__)
+        return __builtin_ctzl(v);
+#else
+        uint8_t n = 0;
+        while (!(v & 1)) { v >>= 1; n++; }
+        return n;
+#endif
+    };
+    /**
+     * Start the non-blocking read of the device at _cursor, skipping those with nothing to read
+     */
+    void         next(void);
+
+    /**
+     * Store a value into the back buffer of the packed image
+     * @param offset    starting bit
+     * @param size      number of bits
+     * @param data      value to store
+     */
+    void         putBits(uint16_t offset, uint8_t size, uint32_t data);
+};
+
+#endif // ExpanderBus_h
@@ -0,0 +1,211 @@
+/*!
+   @file I2Cadda.cpp
+
+   Burst sampling driver for the PCF8591 4x A/D, 1x D/A converter.
+
+   The PCF8591 starts a new conversion on every byte it sends, and the first
+   byte of every read is left over from the previous read cycle.  I2Cexpander's
+   read() pays a full START/address/STOP for one 4-channel snapshot; I2Cadda
+   reads up to (Wire buffer - 1) conversions per request and averages them:
+
+    <pre>
+    I2Cadda adc;
+
+    setup() {
+        Wire.begin();
+        adc.init(0);        // 0x48
+        adc.oversample(2);  // 16 conversions per result, 10 bit values
+    }
+    loop() {
+        adc.sampleAll();    // 64 conversions, 3 transactions on an AVR
+        if (adc.average(0) > THRESHOLD) ...
+    }
+    </pre>
+
+   The D/A output is written the same way - one control byte followed by as
+   many samples as fit in the Wire buffer - so fades and sound are limited by
+   the bus clock rather than per-sample START/address/STOP overhead.
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cadda.h"
+#include "I2Cchip.h"
+
+I2Cadda::I2Cadda() {
+    _i2c_address = -1;
+    _mux         = 0;
+    _channel     = 0;
+    _control     = 0;
+    _bits        = 0;
+    _status      = I2Cexpander::STATUS_IDLE;
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+        _head[c] = 0;
+        _fill[c] = 0;
+        for (uint8_t x = 0; x < I2CADDA_RING; x++) {
+            _ring[c][x] = 0;
+        }
+    }
+}
+
+void I2Cadda::init(size_t address) {
+    _mux         = I2Cexpander::muxOf(address);
+    _channel     = I2Cexpander::channelOf(address);
+    _i2c_address = I2Cchip::PCF8591::address(address & 0xFF);
+    I2Cchip::PCF8591::init(_i2c_address, 0);       // (nothing to set up: the control byte goes with each transfer)
+}
+
+// Read "count" conversions, in as many requests as the Wire buffer needs.
+// The control byte is re-sent with each request so the channel sequence always
+// starts from a known place, and the stale first byte of each read is dropped.
+// A failed request abandons the rest, so sums may hold partial data.
+uint8_t I2Cadda::burst(uint8_t control, uint16_t count, uint32_t *sums) {
+    uint8_t channel = 0;
+    uint8_t step    = (control & PCF8591_AUTOINC) ? 1 : 0;
+    uint8_t max     = I2C_EXPANDER_BUFFER - 1;
+    if (step) {
+        max -= max % CHANNELS;  // keep each request aligned on a full round-robin
+    }
+    if (!select()) {
+        return _status;
+    }
+    while (count) {
+        uint8_t n = (count > max) ? max : count;
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(_control | control);
+        uint8_t status = Wire.endTransmission(false);   // repeated start
+        if (!I2Cchip::ok(status)) {
+            return status;
+        }
+
+        if (Wire.requestFrom(_i2c_address, (uint8_t)(n + 1)) != n + 1) {
+            return I2Cexpander::STATUS_ADDR_NACK;
+        }
+        Wire.read();                    // previous conversion, ignore it
+        for (uint8_t x = 0; x < n; x++) {
+            sums[channel] += Wire.read() & 0xFF;
+            channel = (channel + step) % CHANNELS;
+        }
+        count -= n;
+    }
+    return I2Cexpander::STATUS_OK;
+}
+
+uint16_t I2Cadda::sample(uint8_t channel) {
+    uint32_t sum = 0;
+    channel &= PCF8591_CHANNEL;
+    _status = burst(channel, 1U << (2 * _bits), &sum);
+    if (_status != I2Cexpander::STATUS_OK) {
+        return value(channel);
+    }
+    uint16_t v = sum >> _bits;      // 4^bits samples, keep bits extra bits
+    push(channel, v);
+    return v;
+}
+
+void I2Cadda::sampleAll(void) {
+    uint32_t sums[CHANNELS] = { 0, 0, 0, 0 };
+    _status = burst(PCF8591_AUTOINC, CHANNELS * (1U << (2 * _bits)), sums);
+    if (_status != I2Cexpander::STATUS_OK) {
+        return;
+    }
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+        push(c, sums[c] >> _bits);
+    }
+}
+
+void I2Cadda::push(uint8_t channel, uint16_t v) {
+    _head[channel] = (_head[channel] + 1) % I2CADDA_RING;
+    _ring[channel][_head[channel]] = v;
+    if (_fill[channel] < I2CADDA_RING) {
+        _fill[channel]++;
+    }
+}
+
+uint16_t I2Cadda::history(uint8_t channel, uint8_t age) {
+    channel &= PCF8591_CHANNEL;
+    if (age >= I2CADDA_RING) {
+        age = I2CADDA_RING - 1;
+    }
+    return _ring[channel][(_head[channel] + I2CADDA_RING - age) % I2CADDA_RING];
+}
+
+uint16_t I2Cadda::average(uint8_t channel) {
+    uint32_t sum = 0;
+    channel &= PCF8591_CHANNEL;
+    if (_fill[channel] == 0) {
+        return 0;
+    }
+    for (uint8_t age = 0; age < _fill[channel]; age++) {
+        sum += history(channel, age);
+    }
+    return sum / _fill[channel];
+}
+
+/*
+***************************************************************************
+**                        D/A output                                     **
+***************************************************************************
+ */
+
+void I2Cadda::stream(const uint8_t *samples, uint16_t count) {
+    _control |= PCF8591_DAC_ENABLE;
+    if (!select()) {
+        return;
+    }
+    while (count) {
+        uint8_t n = (count > I2C_EXPANDER_BUFFER - 1) ? I2C_EXPANDER_BUFFER - 1 : count;
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(_control);
+        Wire.write(samples, n);
+        _status = Wire.endTransmission();
+        if (_status != I2Cexpander::STATUS_OK) {
+            return;
+        }
+        samples += n;
+        count   -= n;
+    }
+}
+
+void I2Cadda::stream(I2CaddaSource source, uint16_t count) {
+    uint16_t index = 0;
+    _control |= PCF8591_DAC_ENABLE;
+    if (!select()) {
+        return;
+    }
+    while (count) {
+        uint8_t n = (count > I2C_EXPANDER_BUFFER - 1) ? I2C_EXPANDER_BUFFER - 1 : count;
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(_control);
+        for (uint8_t x = 0; x < n; x++) {
+            Wire.write((*source)(index++));
+        }
+        _status = Wire.endTransmission();
+        if (_status != I2Cexpander::STATUS_OK) {
+            return;
+        }
+        count -= n;
+    }
+}
+
+void I2Cadda::dacOff(void) {
+    _control &= ~PCF8591_DAC_ENABLE;
+    if (!select()) {
+        return;
+    }
+    Wire.beginTransmission(_i2c_address);
+    Wire.write(_control);
+    _status = Wire.endTransmission();
+}
+
+bool I2Cadda::select(void) {
+    I2Cexpander::useClock(I2Cchip::PCF8591::fmax);
+    uint8_t rc = I2Cexpander::route(_mux, _channel);
+    if (rc != I2Cexpander::STATUS_OK) {
+        _status = rc;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,203 @@
+/*!
+ * @file I2Cadda.h
+ *
+ * Burst sampling driver for the PCF8591 4x A/D, 1x D/A converter
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  I2Cexpander reads one 5-byte snapshot of the four A/D channels per read().
+ *  I2Cadda asks the chip for many consecutive conversions in a single
+ *  requestFrom(), either from one channel or round-robin across all four,
+ *  and averages them into higher resolution values that are kept in a
+ *  small per-channel ring buffer.
+ */
+
+#ifndef I2Cadda_h
+#define I2Cadda_h
+
+#include "I2Cexpander.h"
+
+/** How many results to remember per channel */
+#ifndef I2CADDA_RING
+#define I2CADDA_RING    8
+#endif
+
+/**
+ * Generator for streamed D/A output
+ * @param index sample number, counting from 0 for each stream() call
+ * @return the 8-bit D/A value
+ */
+typedef uint8_t (*I2CaddaSource)(uint16_t index);
+
+/**
+ * A PCF8591 as a sampling engine:
+ *    init()
+ *    oversample()
+ *    sample() / sampleAll()
+ *    value() / average() / history()
+ *    dac() / stream() / dacOff()
+ */
+class I2Cadda {
+public:
+    /** Number of A/D channels on the chip */
+    static const uint8_t CHANNELS = 4;
+
+    /*!
+        @brief  I2Cadda class Constructor.
+                No arguments so that it can be either statically initialized OR dynamic.
+    */
+    I2Cadda(void);
+
+    /*!
+        @brief  Initialize the PCF8591 (four single ended inputs).
+        @param    address
+                  Either a zero-based chip sequence number OR the real I2C address
+                  (The same heuristic as I2Cexpander::init(): if address < 0x48, add 0x48),
+                  or an I2Cexpander::muxed() address for a chip behind a mux
+    */
+    void     init(size_t address);
+
+    /*!
+        @brief  How many extra bits of resolution to make by oversampling.
+                Each result averages 4^bits conversions and has (8 + bits) significant bits.
+        @param    bits
+                  [0..4], 0 is a single conversion per result
+    */
+    void     oversample(uint8_t bits)   { _bits = (bits > 4) ? 4 : bits; };
+
+    /*!
+        @brief  Take one (oversampled) result from a single channel.
+                All the conversions are read back-to-back in as few requestFrom()'s as the Wire buffer allows.
+        @param    channel
+                  which A/D [0..3]
+        @return the new result, also stored in the channel's ring buffer.
+                If the transfer failed (see status()) nothing is stored, and the previous result is returned.
+    */
+    uint16_t sample(uint8_t channel);
+
+    /*!
+        @brief  Take one (oversampled) result from each of the four channels, round-robin,
+                using the chip's channel auto-increment.  Nothing is stored if the transfer failed.
+    */
+    void     sampleAll(void);
+
+    /*!
+        @brief  Most recent result for a channel
+        @param    channel
+                  which A/D [0..3]
+        @return (8 + oversample bits) bit value
+    */
+    uint16_t value(uint8_t channel)     { return history(channel, 0); };
+
+    /*!
+        @brief  An older result for a channel
+        @param    channel
+                  which A/D [0..3]
+        @param    age
+                  0 is the most recent, up to I2CADDA_RING - 1
+        @return (8 + oversample bits) bit value
+    */
+    uint16_t history(uint8_t channel, uint8_t age);
+
+    /*!
+        @brief  Mean of the results in a channel's ring buffer, counting only the slots
+                filled so far (up to I2CADDA_RING)
+        @param    channel
+                  which A/D [0..3]
+        @return (8 + oversample bits) bit value, 0 if there are no results yet
+    */
+    uint16_t average(uint8_t channel);
+
+    /*!
+        @brief  Set the D/A output, enabling it if needed.
+        @param    value
+                  8-bit D/A value
+    */
+    void     dac(uint8_t value)         { stream(&value, 1); };
+
+    /*!
+        @brief  Send a buffer of samples to the D/A output.
+                The PCF8591 takes a continuous stream of data bytes after one control byte,
+                so samples are sent (Wire buffer - 1) at a time, each transaction paced by
+                the bus clock (about 44k samples/second at 400kHz).
+        @param    samples
+                  8-bit D/A values
+        @param    count
+                  how many
+    */
+    void     stream(const uint8_t *samples, uint16_t count);
+
+    /*!
+        @brief  Send generated samples to the D/A output, as for stream(samples, count).
+        @param    source
+                  called once per sample, in order
+        @param    count
+                  how many
+    */
+    void     stream(I2CaddaSource source, uint16_t count);
+
+    /*!
+        @brief  Disable the D/A output (it floats, and the chip's oscillator may stop between conversions)
+    */
+    void     dacOff(void);
+
+    /*!
+        @brief  Real I2C Address
+        @return the chip's I2C address
+    */
+    uint8_t  i2caddr(void)              { return _i2c_address; };
+
+    /*!
+        @brief  Outcome of the last sample(), sampleAll(), stream(), dac() or dacOff().
+                A failed stream() stops at the transaction that failed.
+        @return I2Cexpander::STATUS_OK, a Wire error code, or STATUS_IDLE if nothing has been done yet
+    */
+    uint8_t  status(void)               { return _status; };
+    /*!
+        @brief  Did the last transfer succeed?
+        @return TRUE unless it failed
+    */
+    bool     ok(void)                   { return (_status == I2Cexpander::STATUS_OK) || (_status == I2Cexpander::STATUS_IDLE); };
+
+private:
+    uint8_t  _i2c_address;                      ///< Real I2C address
+    uint8_t  _mux;                              ///< I2C address of the mux the chip is behind, 0 if none
+    uint8_t  _channel;                          ///< ...and its channel
+    uint8_t  _control;                          ///< control byte bits common to every transaction (D/A enable)
+    uint8_t  _bits;                             ///< oversampling: extra bits of resolution
+    uint8_t  _status;                           ///< Wire status of the last transfer
+    uint8_t  _head[CHANNELS];                   ///< index of the most recent result
+    uint8_t  _fill[CHANNELS];                   ///< results stored, up to I2CADDA_RING
+    uint16_t _ring[CHANNELS][I2CADDA_RING];     ///< recent results per channel
+
+    /// Control byte bits
+    enum PCF8591Control {
+        PCF8591_DAC_ENABLE  = 0x40,
+        PCF8591_AUTOINC     = 0x04,
+        PCF8591_CHANNEL     = 0x03
+    };
+
+    /**
+     * Read conversions into per-channel sums
+     * @param control   control byte (channel and auto-increment)
+     * @param count     number of conversions wanted
+     * @param sums      per-channel accumulators, indexed from the control byte's starting channel
+     * @return Wire status, STATUS_ADDR_NACK if a request came back short
+     */
+    uint8_t  burst(uint8_t control, uint16_t count, uint32_t *sums);
+    /**
+     * Add a result to a channel's ring buffer
+     * @param channel
+     * @param v
+     */
+    void     push(uint8_t channel, uint16_t v);
+    /**
+     * Open the chip's mux channel, if it has one
+     * @return TRUE if the chip can be reached; otherwise _status holds the mux's error
+     */
+    bool     select(void);
+};
+
+#endif // I2Cadda_h
@@ -0,0 +1,197 @@
+/*!
+   @file I2Cblink.cpp
+
+   Whole-chip driver for the MAX7313 blink and intensity engine.
+
+   Flashing a signal aspect in software rewrites the board's outputs twice a
+   second.  With I2Cblink the flashing pins get their "dark" level in phase 1,
+   and the chip swaps phases on a single configuration bit:
+
+    <pre>
+    I2Cexpander signals;
+    I2Cblink    flasher;
+
+    setup() {
+        Wire.begin();
+        signals.init(0, I2Cexpander::MAX731x, 0x0000);  // 16 outputs
+        flasher.init(0);
+        flasher.master(15);                 // PWM on, full scale
+        flasher.intensity(3, 4);            // pin 3 dimmed to 5/16
+        flasher.blink(true);
+        flasher.flush();
+    }
+    loop() {
+        signals.put(aspects);               // phase 0, as usual
+        flasher.phase1(aspects & ~flashing);
+        flasher.flush();                    // only if phase 1 changed
+        every 500ms: flasher.flip();
+    }
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cblink.h"
+#include "I2Cchip.h"
+
+I2Cblink::I2Cblink() {
+    _i2c_address = -1;
+    _mux         = 0;
+    _channel     = 0;
+    _dirty       = 0;
+    _dimmed      = 0;
+    _status      = I2Cexpander::STATUS_IDLE;
+    _phase0      = 0xFFFF;  // power-on values
+    _phase1      = 0xFFFF;
+    _master      = 0xFF;
+    _config      = I2Cexpander::MAX731x_CONFIG_INT;    // as I2Cexpander::init() leaves it
+    memset(_intensity, 0xFF, sizeof(_intensity));
+}
+
+void I2Cblink::init(size_t address) {
+    _mux         = I2Cexpander::muxOf(address);
+    _channel     = I2Cexpander::channelOf(address);
+    _i2c_address = I2Cchip::MAX731x::address(address & 0xFF);
+    _master      = 0x0F;    // PWM off until master() says otherwise, O16 full
+    _config      = I2Cexpander::MAX731x_CONFIG_INT;
+    // Phase 0 is left alone: it holds whatever I2Cexpander has already written
+    _dirty       = DIRTY_PHASE1 | DIRTY_CONFIG;
+    _dimmed      = 0xFF;
+}
+
+void I2Cblink::phase0(uint16_t bits) {
+    if (bits != _phase0) {
+        _phase0 = bits;
+        _dirty |= DIRTY_PHASE0;
+    }
+}
+
+void I2Cblink::phase1(uint16_t bits) {
+    if (bits != _phase1) {
+        _phase1 = bits;
+        _dirty |= DIRTY_PHASE1;
+    }
+}
+
+void I2Cblink::blink(bool on) {
+    uint8_t c = on ? (_config | I2Cexpander::MAX731x_CONFIG_BLINK) : (_config & ~I2Cexpander::MAX731x_CONFIG_BLINK);
+    if (c != _config) {
+        _config = c;
+        _dirty |= DIRTY_CONFIG;
+    }
+}
+
+void I2Cblink::flip(void) {
+    if (!select()) {
+        return;
+    }
+    Wire.beginTransmission(_i2c_address);
+    Wire.write(I2Cexpander::MAX731x_CONFIG);
+    Wire.write(_config ^ I2Cexpander::MAX731x_CONFIG_FLIP);
+    _status = Wire.endTransmission();
+    if (_status == I2Cexpander::STATUS_OK) {
+        _config ^= I2Cexpander::MAX731x_CONFIG_FLIP;
+    }
+}
+
+void I2Cblink::master(uint8_t level) {
+    uint8_t m = (_master & 0x0F) | ((level & 0x0F) << 4);
+    if (m != _master) {
+        _master = m;
+        _dirty |= DIRTY_CONFIG;
+    }
+}
+
+void I2Cblink::intensity(uint8_t pin, uint8_t level) {
+    if (pin >= PINS) {
+        return;
+    }
+    uint8_t  r     = pin >> 1;
+    uint8_t  shift = (pin & 1) ? 4 : 0;
+    uint8_t  v     = (_intensity[r] & ~(0x0F << shift)) | ((level & 0x0F) << shift);
+    if (v != _intensity[r]) {
+        _intensity[r] = v;
+        bitSet(_dimmed, r);
+    }
+}
+
+uint8_t I2Cblink::intensity(uint8_t pin) {
+    if (pin >= PINS) {
+        return 0;
+    }
+    return (_intensity[pin >> 1] >> ((pin & 1) ? 4 : 0)) & 0x0F;
+}
+
+uint8_t I2Cblink::flush(void) {
+    uint8_t transactions = 0;
+
+    _status = I2Cexpander::STATUS_IDLE;
+    if (dirty() && !select()) {
+        return 0;           // everything stays dirty
+    }
+    if (_dirty & DIRTY_PHASE0) {
+        if (done(writePair(I2Cexpander::MAX731x_PHASE0, 0xff & _phase0, 0xff & (_phase0 >> 8)))) {
+            _dirty &= ~DIRTY_PHASE0;
+        }
+        transactions++;
+    }
+    if (_dirty & DIRTY_PHASE1) {
+        if (done(writePair(I2Cexpander::MAX731x_PHASE1, 0xff & _phase1, 0xff & (_phase1 >> 8)))) {
+            _dirty &= ~DIRTY_PHASE1;
+        }
+        transactions++;
+    }
+    if (_dirty & DIRTY_CONFIG) {
+        if (done(writePair(I2Cexpander::MAX731x_MASTER, _master, _config))) {
+            _dirty &= ~DIRTY_CONFIG;
+        }
+        transactions++;
+    }
+    if (_dimmed) {
+        // the intensity registers auto-increment, so unchanged ones in between are rewritten
+        uint8_t first = 0, last = (PINS / 2) - 1;
+        while (!bitRead(_dimmed, first)) first++;
+        while (!bitRead(_dimmed, last))  last--;
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(I2Cexpander::MAX731x_INTENSITY + first);
+        for (uint8_t r = first; r <= last; r++) {
+            Wire.write(_intensity[r]);
+        }
+        if (done(Wire.endTransmission())) {
+            _dimmed = 0;
+        }
+        transactions++;
+    }
+    return transactions;
+}
+
+bool I2Cblink::done(uint8_t status) {
+    if (status != I2Cexpander::STATUS_OK) {
+        _status = status;
+        return false;
+    }
+    if (_status == I2Cexpander::STATUS_IDLE) {
+        _status = status;
+    }
+    return true;
+}
+
+uint8_t I2Cblink::writePair(uint8_t reg, uint8_t lo, uint8_t hi) {
+    Wire.beginTransmission(_i2c_address);
+    Wire.write(reg);
+    Wire.write(lo);
+    Wire.write(hi);
+    return Wire.endTransmission();
+}
+
+bool I2Cblink::select(void) {
+    I2Cexpander::useClock(I2Cchip::MAX731x::fmax);
+    uint8_t rc = I2Cexpander::route(_mux, _channel);
+    if (rc != I2Cexpander::STATUS_OK) {
+        _status = rc;
+        return false;
+    }
+    return true;
+}
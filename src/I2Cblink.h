@@ -0,0 +1,184 @@
+/*!
+ * @file I2Cblink.h
+ *
+ * Whole-chip driver for the MAX7313 blink and intensity engine
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  I2Cexpander treats a MAX731x as a PCA9555.  The MAX7313 can also hold a
+ *  second set of output levels (blink phase 1) and switch every pin between
+ *  the two sets with one configuration bit, and it can dim each output with
+ *  its own 4-bit PWM intensity under a master intensity.  I2Cblink keeps a
+ *  shadow of those registers and flushes only the ones that changed, using
+ *  the chip's register auto-increment, so a flashing aspect costs one 2-byte
+ *  write per flash instead of a rewrite of every output, and dimming costs
+ *  nothing after setup.
+ *
+ *  The MAX7311 and MAX7312 have only the PCA9555 registers: no phase 1,
+ *  master/O16 or intensity registers, so I2Cblink can't drive them.
+ */
+
+#ifndef I2Cblink_h
+#define I2Cblink_h
+
+#include "I2Cexpander.h"
+
+/**
+ * A MAX7313 as a blink and dimming engine:
+ *    init()
+ *    phase0() / phase1() / blink() / flip()
+ *    master() / intensity()
+ *    flush()
+ */
+class I2Cblink {
+public:
+    /** Number of output pins on the chip */
+    static const uint8_t PINS = 16;
+
+    /*!
+        @brief  I2Cblink class Constructor.
+                No arguments so that it can be either statically initialized OR dynamic.
+    */
+    I2Cblink(void);
+
+    /*!
+        @brief  Initialize the blink and intensity registers.  Call after the chip's I2Cexpander init(),
+                which sets the pin directions.  Every register is marked dirty so that the first
+                flush() writes them all.
+        @param    address
+                  Either a zero-based chip sequence number OR the real I2C address
+                  (The same heuristic as I2Cexpander::init(): if address < 0x20, add 0x10),
+                  or an I2Cexpander::muxed() address for a chip behind a mux
+    */
+    void     init(size_t address);
+
+    /*!
+        @brief  Set the phase 0 output levels - the same register I2Cexpander::write() uses,
+                so leave this alone if an I2Cexpander drives the chip's outputs.
+        @param    bits
+                  one bit per pin
+    */
+    void     phase0(uint16_t bits);
+
+    /*!
+        @brief  Set the phase 1 output levels, shown instead of phase 0 while the chip is flip()ped.
+                Pins that should stay steady get the same value in both phases.
+        @param    bits
+                  one bit per pin
+    */
+    void     phase1(uint16_t bits);
+
+    /*!
+        @brief  Turn the blink engine on or off.  Off, the chip always shows phase 0.
+        @param    on
+    */
+    void     blink(bool on);
+
+    /*!
+        @brief  Swap to the other blink phase - one 2-byte transaction, written immediately.
+                Call at the flash rate (e.g. every 500ms) to flash every pin whose phases differ.
+                If the write fails (see status()) the phase is unchanged.
+    */
+    void     flip(void);
+
+    /*!
+        @brief  Set the master intensity, which scales every pin's intensity.
+        @param    level
+                  [1..15] sixteenths; 0 turns the PWM engine off and the outputs are static
+    */
+    void     master(uint8_t level);
+
+    /*!
+        @brief  Set one pin's PWM intensity.  Only the shadow copy is changed, see flush().
+        @param    pin
+                  [0..15]
+        @param    level
+                  [0..15]
+    */
+    void     intensity(uint8_t pin, uint8_t level);
+
+    /*!
+        @brief  Shadow copy of a pin's intensity
+        @param    pin
+                  [0..15]
+        @return the level, as last set
+    */
+    uint8_t  intensity(uint8_t pin);
+
+    /*!
+        @brief  Write every changed register to the chip, each group in one auto-increment
+                transaction: phase 0, phase 1, master + configuration, and the run of intensity
+                registers from the first changed one to the last.  Groups whose write fails stay
+                dirty, so the next flush() tries them again; see status().
+        @return the number of bus transactions used
+    */
+    uint8_t  flush(void);
+
+    /*!
+        @brief  Is anything waiting to be flush()ed?
+        @return TRUE if there is
+    */
+    bool     dirty(void)        { return (_dirty != 0) || (_dimmed != 0); };
+
+    /*!
+        @brief  Real I2C Address
+        @return the chip's I2C address
+    */
+    uint8_t  i2caddr(void)      { return _i2c_address; };
+
+    /*!
+        @brief  Outcome of the last flip() or flush()
+        @return I2Cexpander::STATUS_OK, the Wire error code of a failed transaction,
+                or STATUS_IDLE if flush() had nothing to write
+    */
+    uint8_t  status(void)       { return _status; };
+    /*!
+        @brief  Did the last flip() or flush() succeed?
+        @return TRUE unless a transaction failed
+    */
+    bool     ok(void)           { return (_status == I2Cexpander::STATUS_OK) || (_status == I2Cexpander::STATUS_IDLE); };
+
+private:
+    /** _dirty bits, one per register group */
+    enum Groups {
+        DIRTY_PHASE0 = 0x01,
+        DIRTY_PHASE1 = 0x02,
+        DIRTY_CONFIG = 0x04     ///< master and configuration, a register pair
+    };
+
+    uint8_t  _i2c_address;      ///< Real I2C address
+    uint8_t  _mux;              ///< I2C address of the mux the chip is behind, 0 if none
+    uint8_t  _channel;          ///< ...and its channel
+    uint8_t  _dirty;            ///< Groups changed since the last flush()
+    uint8_t  _dimmed;           ///< intensity registers changed since the last flush(), bit N for register 0x10 + N
+    uint8_t  _status;           ///< Wire status of the last flip() or flush()
+    uint16_t _phase0;           ///< shadow of the blink phase 0 (output) registers
+    uint16_t _phase1;           ///< shadow of the blink phase 1 registers
+    uint8_t  _master;           ///< shadow of the master/O16 intensity register
+    uint8_t  _config;           ///< shadow of the configuration register
+    uint8_t  _intensity[PINS / 2];  ///< shadow of the output intensity registers
+
+    /**
+     * Write a register pair
+     * @param reg   first register
+     * @param lo    its value
+     * @param hi    the next register's value
+     * @return Wire status
+     */
+    uint8_t  writePair(uint8_t reg, uint8_t lo, uint8_t hi);
+    /**
+     * Note the outcome of one of flush()'s transactions in _status
+     * @param status    its Wire status
+     * @return TRUE if it succeeded
+     */
+    bool     done(uint8_t status);
+    /**
+     * Open the chip's mux channel, if it has one
+     * @return TRUE if the chip can be reached; otherwise _status holds the mux's error
+     */
+    bool     select(void);
+};
+
+#endif // I2Cblink_h
@@ -0,0 +1,467 @@
+/*!
+ * @file I2Cchip.h
+ *
+ * Compile-time chip drivers for I2Cexpander
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Each supported chip is described by a struct of constants (base address,
+ *  data size, register map) and static transaction functions.  I2Cexpander
+ *  dispatches to them at run time from its switch(_chip); Expander<Chip>
+ *  binds to one of them at compile time, so every call inlines straight to
+ *  that chip's transaction sequence and unused drivers are never linked in.
+ *
+ *  <pre>
+ *  Expander<I2Cchip::PCA9555>  signals;
+ *  Expander<I2Cchip::PCF8574>  detectors;
+ *
+ *  setup() {
+ *      signals.init(0, 0x0000);      // 16 outputs
+ *      detectors.init(1, 0xFF);      // 8 inputs
+ *  }
+ *  </pre>
+ */
+
+#ifndef I2Cchip_h
+#define I2Cchip_h
+
+#include "I2Cexpander.h"
+
+namespace I2Cchip {
+
+/**
+ * Resolve either a zero-based chip sequence number OR a real I2C address:
+ * if given address < device_base_address, add the base...
+ */
+inline uint8_t address(size_t a, uint8_t base)  { return (a < base) ? base + a : a; }
+
+/**
+ * Did the (register pointer) write succeed?
+ * Some cores return 7 from endTransmission(false) for a pending repeated start.
+ */
+inline bool    ok(uint8_t n)                    { return (n == 0) || (n == 7); }
+
+/**
+ * Write a 16-bit value to a register pair, only sending the byte(s) that changed.
+ * @return endTransmission() status
+ */
+inline uint8_t writePair(uint8_t addr, uint8_t reg, uint32_t data, uint16_t changed) {
+    Wire.beginTransmission(addr);
+    if ((changed & 0xFF00) == 0) {          // only the low byte changed
+        Wire.write(reg);
+        Wire.write(0xff & data);
+    } else if ((changed & 0x00FF) == 0) {   // only the high byte changed
+        Wire.write(reg + 1);
+        Wire.write(0xff & (data >> 8));
+    } else {
+        Wire.write(reg);
+        Wire.write(0xff & data);            // low byte
+        Wire.write(0xff & (data >> 8));     // high byte
+    }
+    return Wire.endTransmission();
+}
+
+/**
+ * Set a register pointer (or send a control byte) ahead of a read.
+ * @param stop  FALSE to hold the bus for a repeated start
+ * @return endTransmission() status
+ */
+inline uint8_t pointAt(uint8_t addr, uint8_t reg, bool stop = true) {
+    Wire.beginTransmission(addr);
+    Wire.write(reg);
+    return Wire.endTransmission(stop);
+}
+
+/**
+ * Read a 16-bit register pair from the current register pointer.
+ * @return 0, or 2 if the read was NACKed
+ */
+inline uint8_t fetchPair(uint8_t addr, uint32_t &data) {
+    if (Wire.requestFrom(addr, (uint8_t)2, (uint8_t)1) != 2) {
+        return 2;                           // the device NACKed its address
+    }
+    data  = Wire.read();
+    data |= (Wire.read() << 8);
+    return 0;
+}
+
+/*
+ * Every chip's read() is a point() (register pointer write, if the chip has
+ * one) followed by a fetch().  read() runs them back to back with a repeated
+ * start; I2Cexpander's async engine runs them as separate steps.
+ */
+
+/** 8-bit quasi-bidirectional expander, no registers */
+struct PCF8574 {
+    static constexpr uint8_t base    = I2Cexpander::base8574;
+    static constexpr uint8_t size    = I2Cexpander::B8;
+    static constexpr uint8_t chip    = I2Cexpander::PCF8574;
+    static constexpr bool    digital = true;    ///< config bits are pin directions
+    static constexpr uint8_t fmax    = 4;    ///< fastest bus clock, 100kHz units (rated 100kHz, always run at 400kHz here)
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+    static uint32_t mask(uint16_t config)               { return ~config & 0xFF; }   ///< output bits
+    static uint8_t  init(uint8_t addr, uint16_t config) { return write(addr, config, config); }
+
+    static constexpr bool    pointer = false;   ///< no register pointer, point() sends nothing
+
+    static uint8_t  point(uint8_t addr, uint16_t config, bool stop = true) { return 0; }
+    static uint8_t  fetch(uint8_t addr, uint16_t config, uint32_t &data) {
+        Wire.requestFrom(addr, (uint8_t)1);
+        if (!Wire.available()) {
+            return 2;
+        }
+        data = Wire.read();
+        return 0;
+    }
+    static uint8_t  read(uint8_t addr, uint16_t config, uint32_t &data) { return fetch(addr, config, data); }
+    static uint8_t  write(uint8_t addr, uint16_t config, uint32_t data, uint16_t changed = 0xFFFF) {
+        Wire.beginTransmission(addr);
+        Wire.write(0xff & (data | config));     // inputs are written as 1's
+        return Wire.endTransmission();
+    }
+};
+
+/** PCF8574 with a different address range */
+struct PCF8574A : PCF8574 {
+    static constexpr uint8_t base    = I2Cexpander::base8574A;
+    static constexpr uint8_t chip    = I2Cexpander::PCF8574A;
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+};
+
+/** 16-bit expander, INPUT/OUTPUT/INVERT/CONFIG register pairs */
+struct PCA9555 {
+    static constexpr uint8_t base    = I2Cexpander::base9555;
+    static constexpr uint8_t size    = I2Cexpander::B16;
+    static constexpr uint8_t chip    = I2Cexpander::PCA9555;
+    static constexpr bool    digital = true;
+    static constexpr uint8_t fmax    = 4;    ///< 400kHz Fast-mode
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+    static uint32_t mask(uint16_t config)               { return ~config & 0xFFFF; }
+    static uint8_t  init(uint8_t addr, uint16_t config) {
+        Wire.beginTransmission(addr);
+        Wire.write(I2Cexpander::PCA9555_CONFIG);
+        Wire.write(0xff & config);          // low byte
+        Wire.write(config >> 8);            // high byte
+        return Wire.endTransmission();
+    }
+    static constexpr bool    pointer = true;
+
+    static uint8_t  point(uint8_t addr, uint16_t config, bool stop = true) {
+        return pointAt(addr, I2Cexpander::PCA9555_INPUT, stop);
+    }
+    static uint8_t  fetch(uint8_t addr, uint16_t config, uint32_t &data) { return fetchPair(addr, data); }
+    static uint8_t  read(uint8_t addr, uint16_t config, uint32_t &data) {
+        uint8_t n = point(addr, config, false);
+        return ok(n) ? fetch(addr, config, data) : n;
+    }
+    static uint8_t  write(uint8_t addr, uint16_t config, uint32_t data, uint16_t changed = 0xFFFF) {
+        return writePair(addr, I2Cexpander::PCA9555_OUTPUT, data | config, changed);
+    }
+};
+
+/** Register compatible with the PCA9555 */
+struct MCP23016 : PCA9555 {
+    static constexpr uint8_t base    = I2Cexpander::base23016;
+    static constexpr uint8_t chip    = I2Cexpander::MCP23016;
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+};
+
+/** PCA9555 compatible, with an extended address range and a PWM intensity engine */
+struct MAX731x : PCA9555 {
+    static constexpr uint8_t base    = I2Cexpander::base731x;
+    static constexpr uint8_t chip    = I2Cexpander::MAX731x;
+
+    static uint8_t  address(size_t a)                   { return (a < 0x20) ? base + a : a; }
+    static uint8_t  init(uint8_t addr, uint16_t config) {
+        PCA9555::init(addr, config);
+        Wire.beginTransmission(addr);
+        Wire.write(0x0F);  // Config
+        Wire.write(0x08);  //  No Global Brightness
+        return Wire.endTransmission();
+    }
+};
+
+/** 16-bit expander, BANK=0 register pairs with sequential (auto-increment) addressing */
+struct MCP23017 {
+    static constexpr uint8_t base    = I2Cexpander::base23017;
+    static constexpr uint8_t size    = I2Cexpander::B16;
+    static constexpr uint8_t chip    = I2Cexpander::MCP23017;
+    static constexpr bool    digital = true;
+    static constexpr uint8_t fmax    = 10;   ///< 1MHz Fast-mode Plus
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+    static uint32_t mask(uint16_t config)               { return ~config & 0xFFFF; }
+    // The MCP23017 powers up with IOCON.BANK=0 and SEQOP=0, so the A and B registers of each
+    // pair are adjacent and the address pointer auto-increments: every pair is written or read
+    // in a single transaction.
+    static uint8_t  init(uint8_t addr, uint16_t config) {
+        Wire.beginTransmission(addr);
+        Wire.write(I2Cexpander::MCP23017_IODIRA);
+        Wire.write(0xff & config);          // IODIRA - Low byte
+        Wire.write(0xff & (config >> 8));   // IODIRB - High byte
+        uint8_t n = Wire.endTransmission();
+
+        // enable 100k pullups on all inputs...
+        Wire.beginTransmission(addr);
+        Wire.write(I2Cexpander::MCP23017_GPPUA);
+        Wire.write(0xff & config);          // GPPUA - Low byte
+        Wire.write(0xff & (config >> 8));   // GPPUB - High byte
+        uint8_t m = Wire.endTransmission();
+        return n ? n : m;                   // the first failure
+    }
+    static constexpr bool    pointer = true;
+
+    static uint8_t  point(uint8_t addr, uint16_t config, bool stop = true) {
+        return pointAt(addr, I2Cexpander::MCP23017_GPIOA, stop);
+    }
+    static uint8_t  fetch(uint8_t addr, uint16_t config, uint32_t &data) { return fetchPair(addr, data); }
+    static uint8_t  read(uint8_t addr, uint16_t config, uint32_t &data) {
+        uint8_t n = point(addr, config, false);
+        return ok(n) ? fetch(addr, config, data) : n;
+    }
+    static uint8_t  write(uint8_t addr, uint16_t config, uint32_t data, uint16_t changed = 0xFFFF) {
+        return writePair(addr, I2Cexpander::MCP23017_GPIOA, data | config, changed);
+    }
+};
+
+/** One LED channel of a PCA9685, the channel number is the config value */
+struct PCA9685 {
+    static constexpr uint8_t base    = I2Cexpander::base9685;
+    static constexpr uint8_t size    = I2Cexpander::B16;
+    static constexpr uint8_t chip    = I2Cexpander::PCA9685;
+    static constexpr bool    digital = false;
+    static constexpr uint8_t fmax    = 10;   ///< 1MHz Fast-mode Plus
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+    static uint32_t mask(uint16_t config)               { return 0x0FFF; }
+    static uint8_t  init(uint8_t addr, uint16_t config) {
+        Wire.beginTransmission(addr);
+        Wire.write(I2Cexpander::PCA9685_MODE1);
+        Wire.write(I2Cexpander::PCA9685_MODE1_RESTART | I2Cexpander::PCA9685_MODE1_AUTOINC | I2Cexpander::PCA9685_MODE1_ALLCALL);
+        uint8_t n = Wire.endTransmission();
+        delay(1);
+        Wire.beginTransmission(addr);
+        Wire.write(I2Cexpander::PCA9685_MODE2);
+        Wire.write(I2Cexpander::PCA9685_MODE2_TOTEM | I2Cexpander::PCA9685_MODE2_OEOFF);
+        uint8_t m = Wire.endTransmission();
+        delay(1);
+        return n ? n : m;                   // the first failure
+    }
+    static constexpr bool    pointer = true;
+
+    static uint8_t  point(uint8_t addr, uint16_t config, bool stop = true) {
+        return pointAt(addr, I2Cexpander::PCA9685_BASE_LED0 + (config * 4), stop);
+    }
+    static uint8_t  read(uint8_t addr, uint16_t config, uint32_t &data) {
+        uint8_t n = point(addr, config, false);
+        return ok(n) ? fetch(addr, config, data) : n;
+    }
+    static uint8_t  fetch(uint8_t addr, uint16_t config, uint32_t &data) {
+        uint16_t startdata = 0;
+        uint16_t stopdata = 0;
+        if (Wire.requestFrom(addr, (uint8_t)4, (uint8_t)1) != 4) {
+            return 2;
+        }
+        startdata = Wire.read();
+        startdata |= (Wire.read() << 8);
+        stopdata = Wire.read();
+        stopdata |= (Wire.read() << 8);
+        data = (stopdata - startdata) & 0x0FFF;    // the OFF count may have wrapped past 4095
+        return 0;
+    }
+    static uint8_t  write(uint8_t addr, uint16_t config, uint32_t data, uint16_t changed = 0xFFFF) {
+        data = data & 0x0FFF;       // 12 bits
+        // TODO: Stagger starting phase to ensure each string is independent, to reduce power supply spiking
+        Wire.beginTransmission(addr);
+        Wire.write(I2Cexpander::PCA9685_BASE_LED0 + (config * 4));
+        Wire.write(0x00);
+        Wire.write(0x00);
+        Wire.write(0xff & data);            // low
+        Wire.write(0xff & (data >> 8));     // and high bits
+        return Wire.endTransmission();
+    }
+};
+
+/** 4x 8-bit A/D (read as one 32 bit snapshot), 1x 8-bit D/A */
+struct PCF8591 {
+    static constexpr uint8_t base    = I2Cexpander::base8591;
+    static constexpr uint8_t size    = I2Cexpander::B32;
+    static constexpr uint8_t chip    = I2Cexpander::PCF8591;
+    static constexpr bool    digital = false;
+    static constexpr uint8_t fmax    = 4;    ///< rated for 100kHz, but I2Cexpander has always run it at 400kHz
+
+    static uint8_t  address(size_t a)                   { return I2Cchip::address(a, base); }
+    static uint32_t mask(uint16_t config)               { return 0xFF; }
+    static uint8_t  init(uint8_t addr, uint16_t config) { return 0; }
+    static constexpr bool    pointer = true;
+
+    static uint8_t  point(uint8_t addr, uint16_t config, bool stop = true) {
+        return pointAt(addr, 0x04);         // auto-increment, starting at channel 0 (always with a STOP)
+    }
+    static uint8_t  read(uint8_t addr, uint16_t config, uint32_t &data) {
+        uint8_t n = point(addr, config);
+        return ok(n) ? fetch(addr, config, data) : n;
+    }
+    static uint8_t  fetch(uint8_t addr, uint16_t config, uint32_t &data) {
+        if (Wire.requestFrom(addr, (uint8_t)5) != 5) {
+            return 2;
+        }
+
+        Wire.read(); // ignore the Analog Output value
+
+        uint32_t result1 = Wire.read();
+        uint32_t result2 = Wire.read();
+        uint32_t result3 = Wire.read();
+        uint32_t result4 = Wire.read();
+
+        data = ((result4 & 0xFF) << 24) | ((result3 & 0xFF) << 16) | ((result2 & 0xFF) << 8) | ((result1 & 0xFF) << 0);
+        return 0;
+    }
+    static uint8_t  write(uint8_t addr, uint16_t config, uint32_t data, uint16_t changed = 0xFFFF) {
+        Wire.beginTransmission(addr);
+        Wire.write(0x40);                   // D/A enable
+        Wire.write(0xff & data);
+        return Wire.endTransmission();
+    }
+};
+
+} // namespace I2Cchip
+
+
+/**
+ * An I2C expander whose chip type is known at compile time:
+ *    init()
+ *    read() / get()
+ *    write() / put()
+ *
+ * The same API as I2Cexpander (without the run-time features like interrupt mode
+ * or debouncing), but every call inlines to the chip's own transaction sequence.
+ * Writes that would not change the device's outputs are skipped, and 16-bit
+ * chips only write the port byte that changed.
+ */
+template <class Chip>
+class Expander {
+public:
+    /*!
+        @brief  Expander class Constructor.
+                No arguments so that it can be either statically initialized OR dynamic.
+    */
+    Expander(void) : next(0), _i2c_address(0xFF), _config(0), _current(0), _last(0), _lastw(0),
+                     _wvalid(false), _firsttime(true) {}
+
+    /*!
+        @brief  Initialize the device.
+        @param    address
+                  Either a zero-based chip sequence number OR the real I2C address
+        @param    config
+                  Usually, the Input-vs-Output pin direction settings (inputs are "1" bits)
+    */
+    void     init(size_t address, uint16_t config) {
+        _i2c_address = Chip::address(address);
+        _config      = config;
+        _wvalid      = false;
+        Chip::init(_i2c_address, config);
+    }
+
+    /*!
+        @brief  Read data from the device, update the cached state and return the data
+        @return the data from the device (the cached data if the device didn't respond)
+    */
+    uint32_t read(void) {
+        uint32_t data;
+        if (Chip::read(_i2c_address, _config, data) == 0) {
+            _last    = _current;
+            _current = data;
+        }
+        return _current;
+    }
+    /*!
+        @brief  wrapper for read().
+        @return the data from the device
+    */
+    uint32_t get(void)                  { return read(); }
+
+    /*!
+        @brief  Write data to the device, unless it already has it
+        @param data
+                (8, 16 or 32 bits, per the device type)
+    */
+    void     write(uint32_t data) {
+        uint32_t changed = _wvalid ? ((data ^ _lastw) & Chip::mask(_config)) : 0xFFFFFFFFUL;
+        if (changed == 0) {
+            return;
+        }
+        // on failure the chip may have taken part of it, so the next write() sends everything
+        _wvalid = (Chip::write(_i2c_address, _config, data, changed) == 0);
+        _lastw  = data;
+    }
+    /*!
+        @brief  wrapper for write(data).
+        @param data
+    */
+    void     put(uint32_t data)         { next = data; write(next); }
+    /*!
+        @brief  wrapper for write(this->next).
+    */
+    void     put(void)                  { write(next); }
+
+    /*!
+        @brief  Arduino compatibility routine.  Write a bit to the device.
+        @param    dataPin
+                  which bit
+        @param    val
+                  HIGH, 1, LOW, 0
+    */
+    void     digitalWrite(uint8_t dataPin, uint8_t val) { bitWrite(next, dataPin, val); write(next); }
+    /*!
+        @brief  Arduino compatibility routine.  Read the device and return one bit.
+        @param    dataPin
+                  which bit
+        @return  HIGH or LOW
+    */
+    uint8_t  digitalRead(uint8_t dataPin)               { read(); return bitRead(_current, dataPin) ? HIGH : LOW; }
+
+    /*!
+        @brief  Have any INPUT bits changed since the last "read()"?
+        @return TRUE if something changed.
+    */
+    bool     changed(void) {
+        if (_firsttime) {
+            _firsttime = false;
+            _last = ~_current;  // force a true response the first time thru...
+        }
+        return toggled() != 0;
+    }
+    uint32_t toggled(void)              { return (_current ^ _last) & (Chip::digital ? _config : 0xFFFFFFFFUL); }  ///< INPUT bits that changed
+    uint32_t rising(void)               { return toggled() & _current; };  ///< ...from 0 to 1
+    uint32_t falling(void)              { return toggled() & ~_current; }; ///< ...from 1 to 0
+
+    uint16_t getSize(void)              { return Chip::size; };        ///< bits per read/write
+    uint32_t current(void)              { return _current; };          ///< the last read() data
+    uint32_t last(void)                 { return _last; };             ///< the read() before that
+    uint16_t config(void)               { return _config; };           ///< config from init()
+    uint16_t chip(void)                 { return Chip::chip; };        ///< I2Cexpander device_type
+    uint8_t  i2caddr(void)              { return _i2c_address; };      ///< Real I2C address
+
+    /**
+     * collection point for bits to-be-written
+     */
+    uint32_t next;
+
+private:
+    uint8_t  _i2c_address;  ///< Real I2C address
+    uint16_t _config;       ///< per-device-type configuration info
+    uint32_t _current;      ///< current "read" cache
+    uint32_t _last;         ///< last "read"
+    uint32_t _lastw;        ///< last "write"
+    bool     _wvalid;       ///< does _lastw reflect what the device has latched?
+    bool     _firsttime;    ///< private flag for changed() to force an update on first check
+};
+
+#endif // I2Cchip_h
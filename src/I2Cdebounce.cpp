@@ -0,0 +1,95 @@
+/*!
+   @file I2Cdebounce.cpp
+
+   Non-blocking, word-wide input debouncer for I2Cexpander.
+
+   Each input bit has a 3-bit counter of how many consecutive samples have
+   disagreed with its debounced state.  The counters are stored as three
+   "vertical" planes, so one filter() call updates every bit at once:
+
+    <pre>
+    d      = raw ^ state                    bits that disagree
+    c      = (c + 1) & d                    count disagreeing bits, reset the rest
+    done   = d & (c == depth)               bits that have been stable long enough
+    state ^= done, c &= ~done
+    </pre>
+
+   A chattering contact just keeps its own counter from reaching the limit;
+   read() returns immediately with the last stable value.
+
+    <pre>
+    I2Cexpander m;
+    I2Cdebounce filter;
+
+    setup() {
+        m.init(0, I2Cexpander::PCA9555, 0xFFFF);
+        filter.depth(4);                    // 4 samples...
+        filter.depth(0x0003, 7);            // ...except for 2 very noisy pins
+        filter.period(5);                   // at least 5mS apart
+        m.debounce(&filter);
+    }
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cdebounce.h"
+
+I2Cdebounce::I2Cdebounce() {
+    _state  = 0;
+    _c0     = 0;
+    _c1     = 0;
+    _c2     = 0;
+    _t0     = 0;
+    _t1     = 0;
+    _t2     = 0;
+    _period = 0;
+    _tick   = 0;
+    _primed = false;
+    depth(2);
+}
+
+void I2Cdebounce::depth(uint32_t bits, uint8_t n) {
+    if (n < 1)        n = 1;
+    if (n > MAXDEPTH) n = MAXDEPTH;
+    _t0 = (n & 0x01) ? (_t0 | bits) : (_t0 & ~bits);
+    _t1 = (n & 0x02) ? (_t1 | bits) : (_t1 & ~bits);
+    _t2 = (n & 0x04) ? (_t2 | bits) : (_t2 & ~bits);
+}
+
+uint32_t I2Cdebounce::filter(uint32_t raw) {
+    if (!_primed) {
+        _primed = true;
+        _state  = raw;
+        _c0 = _c1 = _c2 = 0;
+        _tick   = millis();
+        return _state;
+    }
+    uint32_t d = raw ^ _state;
+    if (_period) {
+        uint16_t now = millis();
+        if ((uint16_t)(now - _tick) < _period) {
+            // too soon to count this sample, but a bit that has bounced back starts over
+            _c0 &= d;
+            _c1 &= d;
+            _c2 &= d;
+            return _state;
+        }
+        _tick = now;
+    }
+
+    // c = (c + 1) & d, one bit plane at a time
+    uint32_t carry = _c0;
+    _c0 = ~_c0 & d;
+    _c2 = (_c2 ^ (_c1 & carry)) & d;
+    _c1 = (_c1 ^ carry) & d;
+
+    uint32_t done = d & ~((_c0 ^ _t0) | (_c1 ^ _t1) | (_c2 ^ _t2));
+    _state ^= done;
+    _c0 &= ~done;
+    _c1 &= ~done;
+    _c2 &= ~done;
+    return _state;
+}
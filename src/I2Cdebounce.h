@@ -0,0 +1,102 @@
+/*!
+ * @file I2Cdebounce.h
+ *
+ * Non-blocking, word-wide input debouncer for I2Cexpander
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Every input bit has its own small counter, kept "vertically": bit N of
+ *  each counter plane belongs to input pin N, so all 16 (or 32) pins are
+ *  filtered with a handful of word-wide logic operations per read, and a
+ *  chattering contact can never stall the loop.
+ */
+
+#ifndef I2Cdebounce_h
+#define I2Cdebounce_h
+
+#include "I2Cexpander.h"
+
+/**
+ * Per-bit integrating debouncer:
+ *    depth()
+ *    period()
+ *    filter()
+ */
+class I2Cdebounce {
+public:
+    /** Deepest supported filter (3 bit counters) */
+    static const uint8_t MAXDEPTH = 7;
+
+    /*!
+        @brief  I2Cdebounce class Constructor.
+                Defaults to a depth of 2 samples, no minimum sample period.
+    */
+    I2Cdebounce(void);
+
+    /*!
+        @brief  How many consecutive samples must agree before a bit changes state.
+        @param    n
+                  [1..MAXDEPTH], 1 means "no filtering"
+    */
+    void     depth(uint8_t n)                   { depth(0xFFFFFFFFUL, n); };
+
+    /*!
+        @brief  Per-bit version of depth(n)
+        @param    bits
+                  mask of the bits to change
+        @param    n
+                  [1..MAXDEPTH], 1 means "no filtering"
+    */
+    void     depth(uint32_t bits, uint8_t n);
+
+    /*!
+        @brief  Time based filtering: only count samples that are at least this far apart,
+                so a bit must be stable for (depth - 1) * period mS to change.  The samples in
+                between aren't counted, but one that agrees with a bit's debounced state still
+                resets its count.
+        @param    ms
+                  minimum time between counted samples, 0 counts every sample
+    */
+    void     period(uint16_t ms)                { _period = ms; };
+
+    /*!
+        @brief  Feed a new raw sample through the filter.  Never reads the device.
+        @param    raw
+                  the data just read from the device
+        @return the debounced data
+    */
+    uint32_t filter(uint32_t raw);
+
+    /*!
+        @brief  The debounced data from the last filter()
+        @return the debounced data
+    */
+    uint32_t state(void)                        { return _state; };
+
+    /*!
+        @brief  Which bits are currently disagreeing with their debounced state?
+        @return a mask of bits that are bouncing (or in the middle of a real change)
+    */
+    uint32_t unstable(void)                     { return _c0 | _c1 | _c2; };
+
+    /*!
+        @brief  Forget history; the next filter() is accepted as-is.
+    */
+    void     reset(void)                        { _primed = false; };
+
+private:
+    uint32_t _state;        ///< debounced data
+    uint32_t _c0;           ///< counter, bit 0 plane
+    uint32_t _c1;           ///< counter, bit 1 plane
+    uint32_t _c2;           ///< counter, bit 2 plane
+    uint32_t _t0;           ///< per-bit depth, bit 0 plane
+    uint32_t _t1;           ///< per-bit depth, bit 1 plane
+    uint32_t _t2;           ///< per-bit depth, bit 2 plane
+    uint16_t _period;       ///< minimum mS between counted samples
+    uint16_t _tick;         ///< millis() of the last counted sample
+    bool     _primed;       ///< has the first sample been seen?
+};
+
+#endif // I2Cdebounce_h
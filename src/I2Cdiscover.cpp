@@ -0,0 +1,416 @@
+/*!
+   @file I2Cdiscover.cpp
+
+   Bus auto-discovery for I2Cexpander.
+
+   A sweep() is two passes: a zero-length write to every address (just the
+   address byte, so nothing on the bus changes state), and then a fingerprint()
+   of each device that ACKed, working out what it is from the way its
+   registers behave.  Muxes are found first and closed, so the first pass only
+   sees the devices directly on the bus; then each mux channel is opened in
+   turn and swept for the addresses that weren't already taken:
+
+    <pre>
+    Address range   Candidates                              How they are told apart
+    0x10-0x1F       MAX731x                                 only thing we support here
+    0x20-0x27       PCF8574, PCA9555, MCP23016, MCP23017    pointer-less read pattern, CONFIG readback, IOCONA == IOCONB
+    0x38-0x3F       PCF8574A, MAX731x                       pointer-less read pattern, CONFIG readback
+    0x40-0x7F       PCA9685, PCF8591 (0x48-0x4F), MAX731x   ALLCALLADR vs MODE1, pointer-less read pattern
+    </pre>
+
+    Reading a chip without first writing a register pointer returns:
+
+    <pre>
+    PCF8574/A       the port, over and over
+    PCA9555 family  the two registers of a pair, alternating
+    MCP23017        its registers in sequence
+    PCA9685         MODE1 over and over (auto-increment is off at power-on)
+    PCF8591         the previous conversion, then new ones
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cdiscover.h"
+#include "I2Cchip.h"
+
+I2Cdiscover::I2Cdiscover(void) {
+    _count = 0;
+    _muxes = 0;
+    for (uint8_t x = 0; x < sizeof(_present); x++) {
+        _present[x] = 0;
+    }
+}
+
+uint8_t I2Cdiscover::sweep(void) {
+    _count = 0;
+    _muxes = 0;
+    for (uint8_t x = 0; x < sizeof(_present); x++) {
+        _present[x] = 0;
+    }
+    // Close every mux before anything else is probed, or the devices on an
+    // open channel would look like they were directly on the bus
+    for (uint8_t m = 0; m < 8; m++) {
+        uint8_t a = I2Cexpander::baseMux + m;
+        if ((I2Cexpander::probe(a) == I2Cexpander::STATUS_OK) && identifyMux(a)) {
+            bitSet(_muxes, m);
+        }
+    }
+    for (uint8_t a = FIRST; a <= LAST; a++) {
+        if (!isMux(a) && (I2Cexpander::probe(a) == I2Cexpander::STATUS_OK)) {
+            bitSet(_present[a >> 3], a & 0x07);
+        }
+    }
+    // Fingerprint only after every address has been probed, so the register
+    // traffic can't confuse a device that hasn't been looked at yet
+    for (uint8_t a = FIRST; a <= LAST && _count < I2CDISCOVER_MAX; a++) {
+        if (present(a)) {
+            _route[_count]   = 0;
+            _address[_count] = a;
+            _count++;
+        }
+    }
+    identify(0);
+
+    // Behind each mux channel: whatever answers that didn't answer directly
+    for (uint8_t m = 0; m < 8; m++) {
+        if (!bitRead(_muxes, m)) {
+            continue;
+        }
+        for (uint8_t ch = 0; ch < 8; ch++) {
+            if (!muxControl(I2Cexpander::baseMux + m, 1 << ch)) {
+                continue;
+            }
+            uint8_t first = _count;
+            for (uint8_t a = FIRST; a <= LAST && _count < I2CDISCOVER_MAX; a++) {
+                if (!present(a) && !isMux(a) && (I2Cexpander::probe(a) == I2Cexpander::STATUS_OK)) {
+                    _route[_count]   = ROUTED | (m << 3) | ch;
+                    _address[_count] = a;
+                    _count++;
+                }
+            }
+            identify(first);
+            muxControl(I2Cexpander::baseMux + m, 0);
+        }
+    }
+    I2Cexpander::muxReset();    // the muxes have been written behind I2Cexpander's back
+    return _count;
+}
+
+void I2Cdiscover::identify(uint8_t first) {
+    for (uint8_t x = first; x < _count; x++) {
+        _type[x]  = fingerprint(_address[x]);
+        _alias[x] = NONE;
+        // Group addresses are write-only on real chips, so they may not fingerprint at all
+        if ((_type[x] == I2Cexpander::PCA9685) || (_type[x] == I2Cexpander::IGNORE)) {
+            _alias[x] = groupOf(_address[x], _route[x]);
+            if (_alias[x] != NONE) {
+                _type[x] = I2Cexpander::PCA9685;
+            }
+        }
+    }
+}
+
+bool I2Cdiscover::identifyMux(uint8_t address) {
+    static const uint8_t pattern[] = { 0x00, 0x5A, 0xA5 };
+    bool mux = true;
+    for (uint8_t x = 0; mux && (x < sizeof(pattern)); x++) {
+        mux = muxControl(address, pattern[x])
+           && (Wire.requestFrom(address, (uint8_t)1) == 1)
+           && (Wire.read() == pattern[x]);
+    }
+    muxControl(address, 0);     // a PCA9685 just sees its pointer set to MODE1
+    return mux;
+}
+
+bool I2Cdiscover::muxControl(uint8_t address, uint8_t channels) {
+    Wire.beginTransmission(address);
+    Wire.write(channels);
+    return Wire.endTransmission() == I2Cexpander::STATUS_OK;
+}
+
+uint8_t I2Cdiscover::find(uint8_t mux, uint8_t channel, uint8_t address) {
+    for (uint8_t f = 0; f < _count; f++) {
+        if ((_address[f] == address) && (muxaddr(f) == mux) && (!mux || (muxchannel(f) == channel))) {
+            return f;
+        }
+    }
+    return NONE;
+}
+
+void I2Cdiscover::where(uint8_t mux, uint8_t channel, uint8_t address) {
+    Serial.print("0x"); Serial.print(address, HEX);
+    if (mux) {
+        Serial.print(" (mux 0x"); Serial.print(mux, HEX);
+        Serial.print(" channel "); Serial.print(channel, DEC);
+        Serial.print(")");
+    }
+}
+
+bool I2Cdiscover::readReg(uint8_t address, uint8_t reg, uint8_t *buf, uint8_t n) {
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    if (!I2Cchip::ok(Wire.endTransmission(false))) {
+        Wire.endTransmission();
+        return false;
+    }
+    if (Wire.requestFrom(address, n) != n) {
+        return false;
+    }
+    for (uint8_t x = 0; x < n; x++) {
+        buf[x] = Wire.read();
+    }
+    return true;
+}
+
+bool I2Cdiscover::is23017(uint8_t address, bool uniform) {
+    uint8_t b[4];
+    // BANK=0: 0x0A and 0x0B are both IOCON; bit 0 is unimplemented and reads 0.
+    // Then come GPPUA/B.  A PCA9555 masks the pointer to 0x02, and alternates
+    // between its OUTPUT registers (0xFF at power-on)
+    if (!readReg(address, I2Cexpander::MCP23017_IOCONA, b, 4)
+     || (b[0] != b[1]) || (b[0] & 0x01)) {
+        return false;
+    }
+    return uniform || (b[1] != b[2]) || (b[2] != b[3]);
+}
+
+bool I2Cdiscover::is9685(uint8_t address) {
+    uint8_t allcall, again, mode1;
+    // As PCF8591 control bytes, 0x05 and 0x00 leave the D/A output off
+    if (!readReg(address, I2Cexpander::PCA9685_ALLCALLADR, &allcall, 1)
+     || !readReg(address, I2Cexpander::PCA9685_ALLCALLADR, &again,   1)
+     || !readReg(address, I2Cexpander::PCA9685_MODE1,      &mode1,   1)) {
+        return false;
+    }
+    // An 8-bit address (R/W bit clear) that reads back the same, and a MODE1 that isn't it
+    return ((allcall & 0x01) == 0) && (allcall == again) && (mode1 != allcall);
+}
+
+uint8_t I2Cdiscover::fingerprint(uint8_t address) {
+    if ((address >= 0x10) && (address <= 0x1F)) {
+        return I2Cexpander::MAX731x;
+    }
+
+    uint8_t b[4];
+    if (Wire.requestFrom(address, (uint8_t)4) != 4) {
+        return I2Cexpander::IGNORE;
+    }
+    for (uint8_t x = 0; x < 4; x++) {
+        b[x] = Wire.read();
+    }
+    bool same = (b[0] == b[1]) && (b[1] == b[2]) && (b[2] == b[3]);
+    bool pair = !same && (b[0] == b[2]) && (b[1] == b[3]);
+
+    bool low  = (address >= 0x20) && (address <= 0x27);     // PCF8574, PCA9555, MCP2301x
+    bool high = (address >= 0x38) && (address <= 0x3F);     // PCF8574A
+    if (low || high) {
+        if (same) {
+            // A PCF8574, or a 16-bit chip whose two ports read the same.  Point
+            // at CONFIG: a PCF8574 takes 0x06 as its port and can only read back
+            // bits 1 and 2; the others read back what the chip has configured.
+            // (A PCF8574 with both P1 and P2 held low looks like an all-output chip)
+            uint8_t c[2];
+            if (!readReg(address, I2Cexpander::PCA9555_CONFIG, c, 2)) {
+                return I2Cexpander::IGNORE;
+            }
+            if ((c[0] == c[1]) && c[0] && ((c[0] & ~I2Cexpander::PCA9555_CONFIG) == 0)) {
+                Wire.beginTransmission(address);
+                Wire.write(0xFF);           // back to all inputs, as at power-on
+                Wire.endTransmission();
+                return low ? I2Cexpander::PCF8574 : I2Cexpander::PCF8574A;
+            }
+        }
+        // An all-zero MCP23017 and an all-output PCA9555 look alike; a fresh
+        // MCP23017 doesn't read uniformly, so only believe a uniform one then
+        if (low && is23017(address, !same)) {
+            return I2Cexpander::MCP23017;
+        }
+        return low ? I2Cexpander::PCA9555 : I2Cexpander::MAX731x;
+    }
+
+    if (address >= 0x40) {
+        if (is9685(address)) {
+            return I2Cexpander::PCA9685;
+        }
+        if ((address >= 0x48) && (address <= 0x4F)) {
+            return I2Cexpander::PCF8591;
+        }
+    }
+    return pair ? I2Cexpander::MAX731x : I2Cexpander::IGNORE;
+}
+
+uint8_t I2Cdiscover::groupOf(uint8_t address, uint8_t route) {
+    // Each earlier PCA9685 that answers to this address as its ALLCALL or a SUBADRx
+    for (uint8_t x = 0; x < _count; x++) {
+        uint8_t r[6];
+        if ((_type[x] != I2Cexpander::PCA9685) || (_alias[x] != NONE) || (_route[x] != route)
+         || !readReg(_address[x], I2Cexpander::PCA9685_MODE1,      &r[0], 1)
+         || !readReg(_address[x], I2Cexpander::PCA9685_SUBADR1,    &r[2], 1)
+         || !readReg(_address[x], I2Cexpander::PCA9685_SUBADR2,    &r[3], 1)
+         || !readReg(_address[x], I2Cexpander::PCA9685_SUBADR3,    &r[4], 1)
+         || !readReg(_address[x], I2Cexpander::PCA9685_ALLCALLADR, &r[5], 1)) {
+            continue;
+        }
+        if (((r[0] & I2Cexpander::PCA9685_MODE1_ALLCALL) && ((r[5] >> 1) == address))
+         || ((r[0] & I2Cexpander::PCA9685_MODE1_SUBADR1) && ((r[2] >> 1) == address))
+         || ((r[0] & I2Cexpander::PCA9685_MODE1_SUBADR2) && ((r[3] >> 1) == address))
+         || ((r[0] & I2Cexpander::PCA9685_MODE1_SUBADR3) && ((r[4] >> 1) == address))) {
+            return x;
+        }
+    }
+    return NONE;
+}
+
+bool I2Cdiscover::compatible(uint8_t a, uint8_t b) {
+    // What fingerprint() can't tell apart
+    bool wa = (a == I2Cexpander::PCA9555) || (a == I2Cexpander::MCP23016) || (a == I2Cexpander::MAX731x);
+    bool wb = (b == I2Cexpander::PCA9555) || (b == I2Cexpander::MCP23016) || (b == I2Cexpander::MAX731x);
+    return (a == b) || (wa && wb);
+}
+
+const char *I2Cdiscover::name(uint8_t type) {
+    switch (type) {
+        case I2Cexpander::PCA9555:  return "PCA9555";
+        case I2Cexpander::MCP23016: return "MCP23016";
+        case I2Cexpander::MCP23017: return "MCP23017";
+        case I2Cexpander::PCF8574:  return "PCF8574";
+        case I2Cexpander::PCF8574A: return "PCF8574A";
+        case I2Cexpander::PCF8591:  return "PCF8591";
+        case I2Cexpander::MAX731x:  return "MAX731x";
+        case I2Cexpander::PCA9685:  return "PCA9685";
+        default:                    return "unknown";
+    }
+}
+
+size_t I2Cdiscover::initAddress(uint8_t index) {
+    uint8_t a = _address[index];
+    if ((_type[index] == I2Cexpander::MAX731x) && (a < 0x20)) {
+        a -= I2Cexpander::base731x;     // init() adds it back to anything below 0x20
+    }
+    return _route[index] ? I2Cexpander::muxed(muxaddr(index), muxchannel(index), a) : a;
+}
+
+void I2Cdiscover::print(void) {
+    Serial.print("// I2Cdiscover: ");
+    Serial.print(_count, DEC);
+    Serial.println(" device(s)");
+    for (uint8_t m = 0; m < 8; m++) {
+        if (bitRead(_muxes, m)) {
+            Serial.print("    // 0x"); Serial.print(I2Cexpander::baseMux + m, HEX);
+            Serial.println(" TCA9548A/PCA9548 I2C mux");
+        }
+    }
+    uint8_t index = 0;
+    for (uint8_t x = 0; x < _count; x++) {
+        if (_alias[x] != NONE) {
+            Serial.print("    // "); where(muxaddr(x), muxchannel(x), _address[x]);
+            Serial.print(" is a group address of the PCA9685 at 0x");
+            Serial.println(_address[_alias[x]], HEX);
+            continue;
+        }
+        if (_type[x] == I2Cexpander::IGNORE) {
+            Serial.print("    // "); where(muxaddr(x), muxchannel(x), _address[x]);
+            Serial.println(" unknown device");
+            continue;
+        }
+        uint16_t config;
+        switch (_type[x]) {
+            case I2Cexpander::PCF8574:
+            case I2Cexpander::PCF8574A: config = 0x00FF;  break;    // 8 inputs
+            case I2Cexpander::PCA9685:
+            case I2Cexpander::PCF8591:  config = 0x0000;  break;    // channel 0 / no D/A
+            default:                    config = 0xFFFF;  break;    // 16 inputs
+        }
+        uint8_t a = initAddress(x) & 0xFF;
+        Serial.print("    m["); Serial.print(index++, DEC);
+        Serial.print("].init(");
+        if (_route[x]) {
+            Serial.print("I2Cexpander::muxed(0x"); Serial.print(muxaddr(x), HEX);
+            Serial.print(", "); Serial.print(muxchannel(x), DEC);
+            Serial.print(", 0x"); Serial.print(a, HEX);
+            Serial.print(")");
+        } else {
+            Serial.print("0x"); Serial.print(a, HEX);
+        }
+        Serial.print(", I2Cexpander::"); Serial.print(name(_type[x]));
+        Serial.print(", 0x"); Serial.print(config, HEX);
+        Serial.println(");");
+    }
+}
+
+// Is a table entry an I2C device that check() should look at?
+static bool onBus(I2Cexpander &d) {
+    return (d.chip() >= I2Cexpander::FIRSTI2C) && (d.chip() <= I2Cexpander::PCA9685);
+}
+
+uint8_t I2Cdiscover::check(I2Cexpander *devices, uint8_t count) {
+    uint8_t problems = 0;
+    bool    pca9685  = false;
+    for (uint8_t x = 0; x < count; x++) {
+        if (!onBus(devices[x])) {
+            continue;       // on-board pins, or managed elsewhere
+        }
+        uint8_t chip = devices[x].chip();
+        uint8_t a    = devices[x].i2caddr();
+        uint8_t mux  = devices[x].muxaddr();
+        uint8_t ch   = devices[x].muxchannel();
+        pca9685     |= (chip == I2Cexpander::PCA9685);
+        // Two entries on one address: MAX731x #16 and PCA9555 #0 are both 0x20.
+        // Muxed devices only collide on the same channel, but a device directly
+        // on the bus is seen through every channel.
+        // Several PCA9685 entries (one per channel) on one chip are expected.
+        for (uint8_t y = 0; y < x; y++) {
+            uint8_t ymux = devices[y].muxaddr();
+            if (onBus(devices[y]) && (devices[y].i2caddr() == a)
+             && (!mux || !ymux || ((mux == ymux) && (ch == devices[y].muxchannel())))
+             && !((chip == I2Cexpander::PCA9685) && (devices[y].chip() == I2Cexpander::PCA9685))) {
+                Serial.print("m["); Serial.print(x, DEC);
+                Serial.print("] and m["); Serial.print(y, DEC);
+                Serial.print("] are both at "); where(mux, ch, a);
+                Serial.println();
+                problems++;
+            }
+        }
+        uint8_t f = find(mux, ch, a);
+        if (f == NONE) {
+            Serial.print("m["); Serial.print(x, DEC);
+            Serial.print("] "); Serial.print(name(chip));
+            Serial.print(": nothing at "); where(mux, ch, a);
+            Serial.println();
+            problems++;
+            continue;
+        }
+        if ((_type[f] != I2Cexpander::IGNORE) && !compatible(_type[f], chip)) {
+            Serial.print("m["); Serial.print(x, DEC);
+            Serial.print("] "); Serial.print(name(chip));
+            Serial.print(": "); where(mux, ch, a);
+            Serial.print(" looks like a "); Serial.println(name(_type[f]));
+            problems++;
+        }
+    }
+    for (uint8_t f = 0; f < _count; f++) {
+        bool claimed = (_alias[f] != NONE);    // a PCA9685 group address
+        for (uint8_t x = 0; x < count && !claimed; x++) {
+            claimed = onBus(devices[x]) && (devices[x].i2caddr() == _address[f])
+                   && (devices[x].muxaddr() == muxaddr(f))
+                   && (!_route[f] || (devices[x].muxchannel() == muxchannel(f)));
+        }
+        pca9685 |= (_type[f] == I2Cexpander::PCA9685);
+        if (!claimed) {
+            where(muxaddr(f), muxchannel(f), _address[f]);
+            Serial.print(" ("); Serial.print(name(_type[f]));
+            Serial.println(") is not in the table");
+            problems++;
+        }
+    }
+    if (pca9685 && isMux(I2Cexpander::baseMux)) {
+        // I2Cexpander and I2Cpwm turn ALLCALL on, so every PCA9685 sees the mux's
+        // control bytes, and I2CpwmGroup::ALLCALL writes land in the mux
+        Serial.println("the mux at 0x70 shares the PCA9685 ALLCALL address: move it to 0x71-0x77");
+        problems++;
+    }
+    return problems;
+}
@@ -0,0 +1,212 @@
+/*!
+ * @file I2Cdiscover.h
+ *
+ * Bus auto-discovery for I2Cexpander
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  Sweeps the bus with zero-length probes, guesses what each responding
+ *  device is from the way its registers behave, and prints a device table
+ *  that can be pasted into a sketch.  It can also check a sketch's own
+ *  table against what is actually on the bus.
+ *
+ *  TCA9548A/PCA9548 muxes at 0x70-0x77 are recognized by their control
+ *  register, and every channel of each one is swept in turn for the devices
+ *  behind it.  Muxes are left with every channel closed.
+ *
+ *  Fingerprinting is a heuristic, meant for commissioning a node before its
+ *  devices are init()'d.  Only register pointer bytes are written to chips
+ *  that have registers.  A PCF8574 candidate briefly has its port written
+ *  (ending in its all-high power-on state), because that is the only way to
+ *  tell it apart from a 16-bit chip whose two ports read the same.
+ */
+
+#ifndef I2Cdiscover_h
+#define I2Cdiscover_h
+
+#include "I2Cexpander.h"
+
+#ifndef I2CDISCOVER_MAX
+#if defined(RAMEND) && (RAMEND < 0x1000)
+#define I2CDISCOVER_MAX     32      ///< Max number of devices remembered by a sweep()
+#else
+#define I2CDISCOVER_MAX     112     ///< every non-reserved address
+#endif
+#endif
+
+/**
+ * Find out what is on the bus:
+ *    sweep()
+ *    print()
+ *    check()
+ */
+class I2Cdiscover {
+public:
+    static const uint8_t FIRST = 0x08;  ///< lowest non-reserved 7-bit address
+    static const uint8_t LAST  = 0x77;  ///< highest non-reserved 7-bit address
+
+    /*!
+        @brief  I2Cdiscover class Constructor.
+    */
+    I2Cdiscover(void);
+
+    /*!
+        @brief  Probe every address from FIRST to LAST, then fingerprint the ones that answered.
+                Then do the same on each channel of every mux found.
+        @return the number of devices found (not counting the muxes)
+    */
+    uint8_t  sweep(void);
+
+    /*!
+        @brief  Guess what kind of device is at an address
+        @param    address
+                  7-bit I2C address of a device known to be present
+        @return an I2Cexpander::ExpanderType, or I2Cexpander::IGNORE if it isn't recognized.
+                The PCA9555, MCP23016 and MAX731x are register compatible and may be reported as each other.
+    */
+    static uint8_t fingerprint(uint8_t address);
+
+    /*!
+        @brief  Did anything directly on the bus (not behind a mux) answer at this address in the last sweep()?
+        @param    address
+                  7-bit I2C address
+        @return TRUE if it ACKed
+    */
+    bool     present(uint8_t address)   { return (address < 0x80) && bitRead(_present[address >> 3], address & 0x07); };
+
+    uint8_t  count(void)                { return _count; };           ///< devices found by the last sweep()
+    uint8_t  address(uint8_t index)     { return _address[index]; };  ///< I2C address of a found device
+    uint8_t  type(uint8_t index)        { return _type[index]; };     ///< its fingerprint()
+    /// Is a found device really a PCA9685 ALLCALL or SUBADRx group address?
+    bool     alias(uint8_t index)       { return _alias[index] != NONE; };
+    /// The mux a found device is behind, 0 if it is directly on the bus
+    uint8_t  muxaddr(uint8_t index)     { return _route[index] ? I2Cexpander::baseMux + ((_route[index] >> 3) & 0x07) : 0; };
+    /// ...and which of its channels
+    uint8_t  muxchannel(uint8_t index)  { return _route[index] & 0x07; };
+    /*!
+        @brief  The address to give I2Cexpander::init() for a found device, as print() prints it
+        @param    index
+        @return a 7-bit address, MAX731x index or I2Cexpander::muxed() address
+    */
+    size_t   initAddress(uint8_t index);
+    /// Did the last sweep() find a TCA9548A/PCA9548 mux at this address?
+    bool     isMux(uint8_t address)     { return ((address & 0xF8) == I2Cexpander::baseMux) && bitRead(_muxes, address & 0x07); };
+
+    /*!
+        @brief  Print the devices found as I2Cexpander init() calls, ready to paste into setup().
+                Every digital device is configured as all inputs.
+    */
+    void     print(void);
+
+    /*!
+        @brief  Compare a sketch's device table with the last sweep(), printing each problem:
+                two entries that resolve to the same I2C address and mux channel, entries with
+                nothing at their address, entries whose chip type doesn't match the fingerprint,
+                devices on the bus that no entry claims, and a mux at 0x70 on a bus with PCA9685s
+                (0x70 is their ALLCALL address).  PCA9685 group addresses are not problems.
+        @param    devices
+                  the sketch's I2Cexpander table, already init()'d
+        @param    count
+                  how many entries
+        @return the number of problems found
+    */
+    uint8_t  check(I2Cexpander *devices, uint8_t count);
+
+    /*!
+        @brief  Name of an ExpanderType
+        @param    type
+        @return "PCA9555", "PCF8574", ... or "unknown"
+    */
+    static const char *name(uint8_t type);
+
+private:
+    uint8_t  _present[16];                  ///< bitmap of addresses that ACKed
+    uint8_t  _count;                        ///< devices found
+    uint8_t  _address[I2CDISCOVER_MAX];     ///< their addresses...
+    uint8_t  _type[I2CDISCOVER_MAX];        ///< ...and fingerprints
+    uint8_t  _alias[I2CDISCOVER_MAX];       ///< index of the PCA9685 this is a group address of, or NONE
+    uint8_t  _route[I2CDISCOVER_MAX];       ///< ROUTED | mux number << 3 | channel, or 0 if directly on the bus
+    uint8_t  _muxes;                        ///< bitmap of the muxes found, bit N for 0x70 + N
+
+    static const uint8_t NONE   = 0xFF;     ///< not an alias, not found
+    static const uint8_t ROUTED = 0x80;     ///< _route flag
+
+    /**
+     * Is there a TCA9548A/PCA9548 at this address?  Its control register reads back
+     * what was written; a PCA9685 (the only other chip up here) takes the bytes as
+     * register pointers, and reads back MODE1 or a channel register.
+     * Leaves a mux with every channel closed.
+     * @param address
+     * @return TRUE if it behaves like a mux
+     */
+    static bool identifyMux(uint8_t address);
+    /**
+     * Write a mux's control register
+     * @param address
+     * @param channels  bitmap of the channels to connect
+     * @return TRUE if it was ACKed
+     */
+    static bool muxControl(uint8_t address, uint8_t channels);
+    /**
+     * Fingerprint the devices found from index "first" on, all on the same route
+     * @param first
+     */
+    void        identify(uint8_t first);
+    /**
+     * Find a device in the last sweep()
+     * @param mux       I2C address of its mux, 0 if none
+     * @param channel
+     * @param address
+     * @return its index, or NONE
+     */
+    uint8_t     find(uint8_t mux, uint8_t channel, uint8_t address);
+    /**
+     * Print an address and, for a muxed device, its route
+     * @param mux
+     * @param channel
+     * @param address
+     */
+    static void where(uint8_t mux, uint8_t channel, uint8_t address);
+
+    /**
+     * Point at a register and read it back
+     * @param address
+     * @param reg       register pointer (or, for a PCF8574, port data) byte
+     * @param buf       where to put the data
+     * @param n         how many bytes
+     * @return TRUE if all n bytes were read
+     */
+    static bool readReg(uint8_t address, uint8_t reg, uint8_t *buf, uint8_t n);
+    /**
+     * Does the device behave like an MCP23017 (IOCONA and IOCONB are the same register)?
+     * @param address
+     * @param uniform   accept IOCON and GPPU all reading the same
+     * @return TRUE if it does
+     */
+    static bool is23017(uint8_t address, bool uniform);
+    /**
+     * Does the device behave like a PCA9685 (ALLCALLADR holds an 8-bit address, MODE1 is something else)?
+     * Uses register pointers that are harmless control bytes to a PCF8591.
+     * @param address
+     * @return TRUE if it does
+     */
+    static bool is9685(uint8_t address);
+    /**
+     * Which PCA9685 already found on the same route answers to this address as its ALLCALL or an enabled SUBADRx?
+     * @param address
+     * @param route     where address was found
+     * @return its index, or NONE
+     */
+    uint8_t     groupOf(uint8_t address, uint8_t route);
+    /**
+     * Are two device types register compatible as far as I2Cexpander is concerned?
+     * @param a
+     * @param b
+     * @return TRUE if they are
+     */
+    static bool compatible(uint8_t a, uint8_t b);
+};
+
+#endif // I2Cdiscover_h
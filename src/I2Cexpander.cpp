@@ -13,11 +13,14 @@
    It is built on top of the base Wire infrastructure, and coexists (but does not inter-operate) with
    other I2C device libraries.
 
-   This version is limited to a single I2C bus; it does not know how to manage/route through I2C muxes or
-   switch between different MCU I2C appliances.
+   This version is limited to a single I2C bus; it does not know how to switch between different MCU
+   I2C appliances.  Devices can be placed behind TCA9548A/PCA9548 I2C muxes (see muxed()); the selected
+   mux channel is remembered, so the control byte is only sent when a different channel is needed.
 
    The digitalWrite/Read functions are convenience interfaces, but not very performant -
    You should use the Arduino provided ones for onboard pins if you need performance.
+   On the ATmega328 (ARDIO_*) and ATmega32u4 (CPNODE_*) the virtual expanders themselves
+   read and write the MCU's port registers directly, a whole 4 or 8 bit port at a time.
 
    The support for PHOTON is rudimentary - their emulation of the Arduino environment is problematic.
 
@@ -95,6 +98,8 @@
  */
 
 #include "I2Cexpander.h"
+#include "I2Cdebounce.h"
+#include "I2Cchip.h"
 #if defined(ARDUINO) && ARDUINO >= 100
 #include "Arduino.h"
 #include <Wire.h>
@@ -105,12 +110,51 @@
 // #define I2C_EXTENDER_ONBOARD_DEBUG
 // #define I2C_EXTENDER_DEBUG
 // #define I2C_EXTENDER_INVERTLOCAL  - writing a "1" puts port ON (@5v) rather than OFF @0v
+// #define I2C_EXTENDER_NO_PORTIO    - use digitalRead/digitalWrite for the virtual expanders
+
+// The virtual expanders' pins are fixed, so when the MCU is known, map them
+// straight onto its PORT/PIN registers at compile time instead of paying for the
+// Arduino pin lookup tables on every bit.
+#if !defined(I2C_EXTENDER_NO_PORTIO)
+#if defined(ARDUINO_AVR_DUEMILANOVE) && (defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__))
+#define I2C_EXTENDER_PORTIO_328
+#endif
+#if defined(ARDUINO_AVR_LEONARDO) && defined(__AVR_ATmega32U4__)
+#define I2C_EXTENDER_PORTIO_32U4
+#endif
+#endif
+
+#if defined(I2C_EXTENDER_PORTIO_328) || defined(I2C_EXTENDER_PORTIO_32U4)
+/**
+ * Change only the "mask" bits of an output PORT register.
+ * Interrupts are held off so an ISR's changes to the same port aren't lost.
+ * (Unlike digitalWrite(), this does not turn off analogWrite() PWM on the pin)
+ */
+static inline void portWrite(volatile uint8_t *port, uint8_t mask, uint8_t bits) {
+    uint8_t sreg = SREG;
+    cli();
+    *port = (*port & ~mask) | (bits & mask);
+    SREG = sreg;
+}
+#endif
 
 /**
  * Library version
  */
 const char *I2Cexpander::version = "2.0.3";
 
+uint8_t  I2Cexpander::_busClock        = 0;
+uint8_t  I2Cexpander::_muxSelected     = 0;
+uint8_t  I2Cexpander::_muxChannel      = 0;
+
+uint32_t I2Cexpander::_epoch           = 1;
+uint32_t I2Cexpander::_epochMicros     = 0;
+uint32_t I2Cexpander::_freshness       = 0;
+
+uint8_t  I2Cexpander::_retries         = 1;
+uint8_t  I2Cexpander::_quarantineAfter = 4;
+uint16_t I2Cexpander::_reprobeMs       = 1000;
+
 I2Cexpander::I2Cexpander() {
     _chip        = -1;
     _config      = -1;   
@@ -120,14 +164,62 @@ I2Cexpander::I2Cexpander() {
     _size        = B_UNKNOWN;
     _i2c_address = -1; // default
 	_debounce    = 0;
+    _primed      = false;
+    _raw         = 0;
+    _debouncer   = NULL;
+    _lastw       = 0;
+    _wvalid      = false;
+    _policy      = ELIDE_NONE;
+    _saved       = 0;
+    _intpin      = -1;
+    _intstale    = false;
+    _status      = STATUS_IDLE;
+    _health      = HEALTHY;
+    _failures    = 0;
+    _probed      = 0;
+    _pending     = false;
+    _dirty       = false;
+    _stamp       = 0;
+    _step        = STEP_IDLE;
+    _tries       = 0;
+    _clock       = CLOCK_400K / 100000UL;
+    _mux         = 0;
+    _channel     = 0;
     next         = 0;
     debugflag    = 0;
+#ifdef I2C_EXPANDER_STATS
+    resetStats();
+#endif
 }
 
 I2Cexpander::I2Cexpander(I2Cexpander::ExpanderType device_type, size_t address, boolean debounce) {
     _chip        = device_type;
-    _i2c_address = address;
+    _i2c_address = address & 0xFF;
+    _step        = STEP_IDLE;
+    _tries       = 0;
+    _clock       = CLOCK_400K / 100000UL;
+    _mux         = (address & MUX_ROUTED) ? baseMux + ((address >> 11) & 0x07) : 0;
+    _channel     = (address >> 8) & 0x07;
 	_debounce    = debounce;
+    _primed      = false;
+    _raw         = 0;
+    _debouncer   = NULL;
+    _lastw       = 0;
+    _wvalid      = false;
+    _policy      = ELIDE_NONE;
+    _saved       = 0;
+    _intpin      = -1;
+    _intstale    = false;
+    _status      = STATUS_IDLE;
+    _health      = HEALTHY;
+    _failures    = 0;
+    _probed      = 0;
+    _pending     = false;
+    _dirty       = false;
+    _stamp       = 0;
+#ifdef I2C_EXPANDER_STATS
+    resetStats();
+#endif
 
     _config      = -1;
     _last        = -1;
@@ -138,7 +230,7 @@ I2Cexpander::I2Cexpander(I2Cexpander::ExpanderType device_type, size_t address,
     debugflag    = 0;
 }
 void I2Cexpander::init(uint16_t config) {
-    init(_i2c_address, _chip, config, _debounce);
+    init(_mux ? muxed(_mux, _channel, _i2c_address) : _i2c_address, _chip, config, _debounce);
 }
 
 void I2Cexpander::init(size_t address, uint16_t device_type, uint16_t config, boolean debounce /* == false */ ) {
@@ -154,8 +246,28 @@ void I2Cexpander::init(size_t address, uint16_t device_type, uint16_t config, bo
     _config      = config;
     _i2c_address = -1; // default
     _debounce    = debounce;
+    _primed      = false;
+    _debouncer   = NULL;
+    _wvalid      = false;   // don't know what the device has latched until the first write()
+    _intpin      = -1;      // polling until interruptMode() says otherwise
+    _intstale    = false;
+    _status      = STATUS_IDLE;
+    _health      = HEALTHY;
+    _failures    = 0;
+    _pending     = false;
+    _dirty       = false;
+    _stamp       = 0;
+    _step        = STEP_IDLE;
+    _mux         = 0;
+    _channel     = 0;
+    if (address & MUX_ROUTED) {
+        _mux     = baseMux + ((address >> 11) & 0x07);
+        _channel = (address >> 8) & 0x07;
+        address &= 0xFF;
+    }
 
-    Wire.setClock(400000UL);
+    clampClock();           // _clock is kept from setClock(), which may come before init()
+    select();
 
     switch (_chip) {
         case I2Cexpander::MAX731x:    _size = B16; init731x( address, _config);  break;
@@ -197,11 +309,30 @@ void I2Cexpander::init(size_t address, uint16_t device_type, uint16_t config, bo
 }
 
 void I2Cexpander::digitalWrite(uint8_t dataPin, uint8_t val) {
-    bitWrite(next, dataPin, val); I2Cexpander::write(next);
+    bitWrite(next, dataPin, val); I2Cexpander::put();
+}
+
+void I2Cexpander::refresh(void) {
+    _epoch++;
+    _epochMicros = micros();
+}
+
+bool I2Cexpander::commit(void) {
+    if (!_dirty) {
+        return false;
+    }
+    _dirty = false;
+    I2Cexpander::write(next);
+    return true;
 }
 
 uint8_t  I2Cexpander::digitalRead(uint8_t dataPin) {
-    get();
+    if (_freshness && (micros() - _epochMicros >= _freshness)) {
+        refresh();
+    }
+    if (!(_policy & CACHE_READS) || (_stamp != _epoch)) {
+        get();
+    }
     return bitRead(_current, dataPin) ? HIGH : LOW; 
 }
 
@@ -210,10 +341,7 @@ bool  I2Cexpander::changed() {
         I2Cexpander::_firsttime = 0;
         I2Cexpander::_last = ~I2Cexpander::_current;  // force a true response the first time thru...
     }
-    if ((I2Cexpander::_chip == I2Cexpander::PCF8591) || (I2Cexpander::_chip == I2Cexpander::PCA9685)) {
-        return ((I2Cexpander::_current) != (I2Cexpander::_last));  // no I/O direction mask
-    }
-    return ((I2Cexpander::_current & I2Cexpander::_config) != (I2Cexpander::_last & I2Cexpander::_config));
+    return toggled() != 0;      // analog devices have no I/O direction mask
 };
 
 void I2Cexpander::printData(uint32_t d) {
@@ -233,17 +361,53 @@ void I2Cexpander::printString(const char *tag) {
     Serial.print(", data size=");     Serial.print(_size,      DEC);	
 }
 
-// Software Debounce
+void I2Cexpander::debounce(I2Cdebounce *engine) {
+    _debouncer = engine;
+    _debounce  = (engine != NULL);
+    if (engine) {
+        engine->reset();
+    }
+}
+
+// Software Debounce - one read per call, never loops on a chattering input
 uint32_t I2Cexpander::read(void) {  
-    uint32_t    v1 = _read();
+    if (!available()) {
+        _last = _current;   // quarantined: nothing new to report
+        return _current;
+    }
+    uint32_t    raw = _read();
+    for (uint8_t r = 0; failed() && (r < _retries); r++) {
+        raw = _read();
+    }
+    if (!settle())
+        return raw;
+    _stamp = _epoch;
     if (!_debounce)
-        return v1;
-    uint32_t    v2 = v1;
-    do {
-        v1 = v2;
-        v2 = _read();
-    } while (v2 != v1);
-    return v1;
+        return raw;
+    return filter(raw);
+}
+
+uint32_t I2Cexpander::filter(uint32_t raw) {
+    uint32_t    v;
+    if (_debouncer) {
+        v = _debouncer->filter(raw);
+#ifdef I2C_EXPANDER_STATS
+        if (_debouncer->unstable() & _config) _stats.retries++;
+#endif
+    } else if (!_primed) {
+        v = raw;
+    } else {
+        // bits that read the same twice in a row take the new value, the rest keep the old one
+        uint32_t stable = ~(raw ^ _raw);
+        v = (_last & ~stable) | (raw & stable);
+#ifdef I2C_EXPANDER_STATS
+        if (~stable & _config) _stats.retries++;
+#endif
+    }
+    _raw     = raw;
+    _primed  = true;
+    _current = v;
+    return v;
 }
 
 // Raw read
@@ -258,6 +422,17 @@ uint32_t I2Cexpander::_read() {
         Serial.print(") "); 
     //}
 #endif
+#ifdef I2C_EXPANDER_STATS
+    uint32_t start = micros();
+#endif
+    _status = STATUS_IDLE;
+    if (cached()) {
+        // All outputs - the pins can only be what we last wrote
+        data = _lastw & sizeMask();
+        _saved++;
+    } else if (!select()) {
+        // the mux didn't answer, _status says why
+    } else
     switch (_chip) {
         case I2Cexpander::MAX731x:        data = read9555();   break; // 731x is same as 9555
         case I2Cexpander::PCA9555:        data = read9555();   break;
@@ -298,6 +473,14 @@ uint32_t I2Cexpander::_read() {
         case BYTE:
             break;
     } 
+#ifdef I2C_EXPANDER_STATS
+    tally(false, start);
+#endif
+    if (failed()) {
+        error = 1;
+        data  = _current;   // keep the last good data, and don't report it as a change
+        _last = _current;
+    }
     if (!error) {      
         I2Cexpander::_last = I2Cexpander::_current;
         I2Cexpander::_current = data;
@@ -335,7 +518,44 @@ void I2Cexpander::write(uint32_t data) {
 		Serial.println(")");
     //}
 #endif
+    if ((_policy & ELIDE_WRITES) && _wvalid) {
+        bool same;
+        if (isDigital()) {
+            same = (((data ^ _lastw) & ~(uint32_t)_config & sizeMask()) == 0);  // input bits are always written as 1's
+        } else if ((_chip == I2Cexpander::PCF8591) || (_chip == I2Cexpander::PCA9685)) {
+            same = (data == _lastw);
+        } else {
+            same = false;   // MCU pins are cheap to write, and may be changed behind our back
+        }
+        if (same) {
+            _saved++;
+            return;
+        }
+    }
 
+    _lastw = data;
+    if (!available()) {
+        _pending = true;    // written when (if) the device comes back
+        _wvalid  = false;
+        return;
+    }
+    _write(data);
+    for (uint8_t r = 0; failed() && (r < _retries); r++) {
+        _wvalid = false;    // the device may have taken part of it, so rewrite everything
+        _write(data);
+    }
+    _wvalid  = settle();
+    _pending = !_wvalid;
+}
+
+void I2Cexpander::_write(uint32_t data) {
+#ifdef I2C_EXPANDER_STATS
+    uint32_t start = micros();
+#endif
+    _status = STATUS_IDLE;
+    if (!select()) {
+        // the mux didn't answer, _status says why
+    } else
     switch (_chip) {
         case I2Cexpander::MAX731x:         write9555(data); break;  // 731x is same as 9555
         case I2Cexpander::PCA9555:         write9555(data); break;
@@ -374,31 +594,344 @@ void I2Cexpander::write(uint32_t data) {
         case BYTE:
         default:  break;
     }
-    _lastw = data;
+#ifdef I2C_EXPANDER_STATS
+    tally(true, start);
+#endif
 }
 
 /*
 ***************************************************************************
-**                                  8  b i t   8574                      **
+**                        Non-blocking reads                             **
 ***************************************************************************
  */
-void I2Cexpander::init8574A(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < base8574A) {
-        a = base8574A + i2caddr;
-    } else {
-        a = i2caddr;
+
+// One bus transaction per poll(), so that a long scan can be spread across
+// loop() passes that also service serial traffic.  read() holds the bus with a
+// repeated start between the register pointer write and the data read; here
+// they are separate transactions (the chips keep their pointer across a STOP).
+bool I2Cexpander::poll(void) {
+#ifdef I2C_EXPANDER_STATS
+    uint32_t start = micros();
+#endif
+    switch (_step) {
+        case STEP_IDLE:
+            return true;
+        case STEP_START:
+            if (!available()) {
+                _last = _current;   // quarantined: nothing new to report
+                _step = STEP_IDLE;
+                return true;
+            }
+            if ((_chip < FIRSTI2C) || (_chip > PCA9685) || cached()
+             || ((_chip == MCP23017) && (_intpin >= 0) && !_intstale && (::digitalRead(_intpin) == HIGH))) {
+                read();             // MCU pins, or no bus transaction needed
+                _step = STEP_IDLE;
+                return true;
+            }
+            _status = STATUS_IDLE;
+            _step   = STEP_POINT;
+            break;
+        default:
+            break;
     }
-    I2Cexpander::init8(a, dir);
+    // Another device may have moved the clock or the mux since our last step
+    speed();
+    if (_mux && !((_mux == _muxSelected) && (_channel == _muxChannel))) {
+        return muxSelect() ? false : fault();
+    }
+    if ((_step == STEP_POINT) && (_chip != PCF8574) && (_chip != PCF8574A)) {
+        _status = point();
+        if (failed()) {
+#ifdef I2C_EXPANDER_STATS
+            tally(false, start);
+#endif
+            return fault();
+        }
+        _step = STEP_FETCH;
+        return false;
+    }
+    uint32_t data = 0;
+    _status = fetch(data);
+#ifdef I2C_EXPANDER_STATS
+    tally(false, start);
+#endif
+    if (failed()) {
+        return fault();
+    }
+    _last    = _current;
+    _current = data;
+    if (settle()) {
+        _stamp = _epoch;
+        if (_debounce) {
+            filter(data);
+        }
+    }
+    _step = STEP_IDLE;
+    return true;
 }
-void I2Cexpander::init8574(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < base8574) {
-        a = base8574 + i2caddr;
+
+bool I2Cexpander::fault(void) {
+    if (_tries < _retries) {
+        _tries++;
+        _step = STEP_POINT;
+        return false;
+    }
+    settle();
+    _last = _current;       // keep the last good data, and don't report it as a change
+    _step = STEP_IDLE;
+    return true;
+}
+
+uint8_t I2Cexpander::point(void) {
+    switch (_chip) {
+        case I2Cexpander::MAX731x:
+        case I2Cexpander::PCA9555:
+        case I2Cexpander::MCP23016:   return I2Cchip::PCA9555::point(_i2c_address, _config);
+        case I2Cexpander::MCP23017:   return (_intpin >= 0) ? I2Cchip::pointAt(_i2c_address, MCP23017_INTFA)
+                                                            : I2Cchip::MCP23017::point(_i2c_address, _config);
+        case I2Cexpander::PCF8591:    return I2Cchip::PCF8591::point(_i2c_address, _config);
+        case I2Cexpander::PCA9685:    return I2Cchip::PCA9685::point(_i2c_address, _config);
+        default:                      return STATUS_OK;
+    }
+}
+
+uint8_t I2Cexpander::fetch(uint32_t &data) {
+    switch (_chip) {
+        case I2Cexpander::MAX731x:
+        case I2Cexpander::PCA9555:
+        case I2Cexpander::MCP23016:   return I2Cchip::PCA9555::fetch(_i2c_address, _config, data);
+        case I2Cexpander::MCP23017:   if (_intpin >= 0) {
+                                          data = fetch23017int();
+                                          return _status;
+                                      }
+                                      return I2Cchip::MCP23017::fetch(_i2c_address, _config, data);
+        case I2Cexpander::PCF8574A:
+        case I2Cexpander::PCF8574:    return I2Cchip::PCF8574::fetch(_i2c_address, _config, data);
+        case I2Cexpander::PCF8591:    return I2Cchip::PCF8591::fetch(_i2c_address, _config, data);
+        case I2Cexpander::PCA9685:    return I2Cchip::PCA9685::fetch(_i2c_address, _config, data);
+        default:                      return STATUS_OK;
+    }
+}
+
+/*
+***************************************************************************
+**                        Errors, retries and quarantine                 **
+***************************************************************************
+ */
+
+void I2Cexpander::retryPolicy(uint8_t retries, uint8_t quarantineAfter, uint16_t reprobeMs) {
+    _retries         = retries;
+    _quarantineAfter = quarantineAfter;
+    _reprobeMs       = reprobeMs;
+}
+
+uint8_t I2Cexpander::probe(uint8_t address) {
+    Wire.beginTransmission(address);
+    return Wire.endTransmission();
+}
+
+bool I2Cexpander::settle(void) {
+    if (ok()) {
+        _failures = 0;
+        _health   = HEALTHY;
+        return true;
+    }
+    if (_failures < 0xFF) {
+        _failures++;
+    }
+    if (_quarantineAfter && (_failures >= _quarantineAfter)) {
+        _health = QUARANTINED;
+        _probed = millis();
     } else {
-        a = i2caddr;
+        _health = DEGRADED;
     }
-    I2Cexpander::init8(a, dir);
+    return false;
+}
+
+// A quarantined device costs one zero-length write every _reprobeMs, instead of
+// (1 + _retries) NACK timeouts on every read() and write()
+bool I2Cexpander::available(void) {
+    if (_health != QUARANTINED) {
+        return true;
+    }
+    uint16_t now = millis();
+    if ((uint16_t)(now - _probed) < _reprobeMs) {
+        _status = STATUS_QUARANTINED;
+        return false;
+    }
+    _probed = now;
+    if (!select() || (probe(_i2c_address) != STATUS_OK)) {
+        _status = STATUS_QUARANTINED;
+        return false;
+    }
+    // It's back, possibly after a power cycle: restore its configuration and outputs
+    _health   = HEALTHY;
+    _failures = 0;
+    _wvalid   = false;
+    reinit();
+    if (_pending) {
+        _write(_lastw);
+        _wvalid  = ok();
+        _pending = !_wvalid;
+    }
+    return true;
+}
+
+void I2Cexpander::setClock(uint32_t hz) {
+    _clock = (hz < 100000UL) ? 1 : (hz > CLOCK_1M) ? (CLOCK_1M / 100000UL) : (hz / 100000UL);
+    clampClock();
+}
+
+void I2Cexpander::clampClock(void) {
+    uint8_t fmax;
+    switch (_chip) {
+        case I2Cexpander::MAX731x:    fmax = I2Cchip::MAX731x::fmax;   break;
+        case I2Cexpander::PCA9555:
+        case I2Cexpander::MCP23016:   fmax = I2Cchip::PCA9555::fmax;   break;
+        case I2Cexpander::MCP23017:   fmax = I2Cchip::MCP23017::fmax;  break;
+        case I2Cexpander::PCF8574A:
+        case I2Cexpander::PCF8574:    fmax = I2Cchip::PCF8574::fmax;   break;
+        case I2Cexpander::PCF8591:    fmax = I2Cchip::PCF8591::fmax;   break;
+        case I2Cexpander::PCA9685:    fmax = I2Cchip::PCA9685::fmax;   break;
+        default:
+            if (_chip != (uint8_t)-1) {
+                _clock = 0;             // MCU pins, no bus
+            }
+            return;                     // (or not init()'d yet)
+    }
+    if (_clock == 0) {
+        _clock = CLOCK_400K / 100000UL;
+    }
+    if (_mux && (fmax > CLOCK_400K / 100000UL)) {
+        fmax = CLOCK_400K / 100000UL;           // the TCA9548A/PCA9548 is a 400kHz part
+    }
+    if (_clock > fmax) {
+        _clock = fmax;
+    }
+}
+
+bool I2Cexpander::muxSelect(void) {
+    uint8_t rc = route(_mux, _channel);
+    if (rc != STATUS_OK) {
+        _status = rc;
+        return false;
+    }
+    return true;
+}
+
+uint8_t I2Cexpander::route(uint8_t mux, uint8_t channel) {
+    if ((mux == 0) || ((mux == _muxSelected) && (channel == _muxChannel))) {
+        return STATUS_OK;
+    }
+    if (_muxSelected && (_muxSelected != mux)) {
+        Wire.beginTransmission(_muxSelected);
+        Wire.write(0x00);       // close the other mux's channels
+        Wire.endTransmission();
+    }
+    _muxSelected = 0;
+    Wire.beginTransmission(mux);
+    Wire.write(1 << channel);
+    uint8_t rc = Wire.endTransmission();
+    if (!I2Cchip::ok(rc)) {
+        return rc;
+    }
+    _muxSelected = mux;
+    _muxChannel  = channel;
+    return STATUS_OK;
+}
+
+void I2Cexpander::reinit(void) {
+    switch (_chip) {
+        case I2Cexpander::MAX731x:    I2Cchip::MAX731x::init( _i2c_address, _config);  break;
+        case I2Cexpander::PCA9555:
+        case I2Cexpander::MCP23016:   I2Cchip::PCA9555::init( _i2c_address, _config);  break;
+        case I2Cexpander::MCP23017:   I2Cchip::MCP23017::init(_i2c_address, _config);
+                                      if (_intpin >= 0) {
+                                          interruptMode(_intpin);
+                                      }
+                                      break;
+        case I2Cexpander::PCF8574A:
+        case I2Cexpander::PCF8574:    I2Cchip::PCF8574::init( _i2c_address, _config);  break;
+        case I2Cexpander::PCA9685:    I2Cchip::PCA9685::init( _i2c_address, _config);  break;
+        default:                                                                        break;
+    }
+}
+
+#ifdef I2C_EXPANDER_STATS
+/*
+***************************************************************************
+**                        Stats                                          **
+***************************************************************************
+ */
+
+uint32_t I2Cexpander::_busBusy  = 0;
+uint32_t I2Cexpander::_busSince = 0;
+
+void I2Cexpander::tally(boolean write, uint32_t start) {
+    if (_status == STATUS_IDLE) {
+        return;     // answered from the cache, or MCU pins
+    }
+    uint32_t us = micros() - start;
+    _busBusy += us;
+    if (write) _stats.writes++;
+    else       _stats.reads++;
+    if (!I2Cchip::ok(_status)) {
+        _stats.errors[(_status < 6) ? _status : 4]++;
+        _stats.lastError = _status;
+    }
+    if (us > 0xFFFF) us = 0xFFFF;
+    if (us < _stats.minMicros) _stats.minMicros = us;
+    if (us > _stats.maxMicros) _stats.maxMicros = us;
+    _stats.totalMicros += us;
+}
+
+void I2Cexpander::resetStats(void) {
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.minMicros = 0xFFFF;
+}
+
+void I2Cexpander::printStats(const char *tag) {
+    printString(tag);
+    Serial.print(", reads=");   Serial.print(_stats.reads,    DEC);
+    Serial.print(", writes=");  Serial.print(_stats.writes,   DEC);
+    Serial.print(", nacks=");   Serial.print(_stats.nacks(),  DEC);
+    Serial.print(", errors=");
+    for (uint8_t e = 1; e < 6; e++) {
+        Serial.print(_stats.errors[e], DEC); Serial.print(e < 5 ? "/" : "");
+    }
+    Serial.print(", retries="); Serial.print(_stats.retries,  DEC);
+    Serial.print(", uS min/avg/max=");
+    Serial.print((_stats.reads + _stats.writes) ? _stats.minMicros : 0, DEC); Serial.print("/");
+    Serial.print(_stats.avgMicros(), DEC);                                    Serial.print("/");
+    Serial.print(_stats.maxMicros,   DEC);
+    Serial.println();
+}
+
+uint8_t I2Cexpander::busUtilization(void) {
+    uint32_t wall = micros() - _busSince;
+    if (wall == 0) {
+        return 0;
+    }
+    uint32_t pct = (uint32_t)(((uint64_t)_busBusy * 100) / wall);
+    return (pct > 100) ? 100 : pct;
+}
+
+void I2Cexpander::busReset(void) {
+    _busBusy  = 0;
+    _busSince = micros();
+}
+#endif
+
+/*
+***************************************************************************
+**                                  8  b i t   8574                      **
+***************************************************************************
+ */
+void I2Cexpander::init8574A(uint8_t i2caddr, uint16_t dir) {
+    I2Cexpander::init8(I2Cchip::PCF8574A::address(i2caddr), dir);
+}
+void I2Cexpander::init8574(uint8_t i2caddr, uint16_t dir) {
+    I2Cexpander::init8(I2Cchip::PCF8574::address(i2caddr), dir);
 }
 void I2Cexpander::init8(uint8_t i2caddr, uint16_t dir) {
     _i2c_address = i2caddr;
@@ -406,21 +939,16 @@ void I2Cexpander::init8(uint8_t i2caddr, uint16_t dir) {
 }
 
 uint32_t I2Cexpander::read8() {
-    uint32_t _data = -1;
-    // Wire.beginTransmission(_i2c_address);
-    Wire.requestFrom(_i2c_address, (uint8_t)1);
-    if(Wire.available()) {
-      _data = Wire.read();
+    uint32_t data;
+    _status = I2Cchip::PCF8574::read(_i2c_address, _config, data);
+    if (_status != 0) {
+        return (_current);
     }
-    // Wire.endTransmission();  
-    return _data;
+    return data;
 }
 
 void I2Cexpander::write8(uint32_t data) {
-    data = data | _config;
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0xff & data);
-    Wire.endTransmission();  
+    _status = I2Cchip::PCF8574::write(_i2c_address, _config, data);
 }
 
 
@@ -429,54 +957,84 @@ void I2Cexpander::write8(uint32_t data) {
 **                                  16 b i t  23017                      **
 ***************************************************************************
  */
+// The register sequences live in I2Cchip::MCP23017, shared with Expander<I2Cchip::MCP23017>.
 void I2Cexpander::init23017(uint8_t i2caddr, uint16_t dir) {
-    if (i2caddr < base23017) {
-        _i2c_address = base23017 + i2caddr;
-    } else {
-        _i2c_address = i2caddr;
+    _i2c_address = I2Cchip::MCP23017::address(i2caddr);
+    I2Cchip::MCP23017::init(_i2c_address, dir);
+}
+
+
+void I2Cexpander::interruptMode(uint8_t intPin) {
+    if (_chip != I2Cexpander::MCP23017) {
+        return;
     }
-    Wire.beginTransmission(i2caddr);
-    Wire.write(MCP23017_IODIRA);
-    Wire.write(0xff & dir);         // Low byte
-    Wire.endTransmission();
+    pinMode(intPin, INPUT_PULLUP);  // open-drain INT needs a pullup
+    select();
 
-    Wire.beginTransmission(i2caddr);
-    Wire.write(MCP23017_IODIRB);
-    Wire.write(0xff & (dir >> 8));  // High byte
+    // One shared, active-low, open-drain INT pin for both ports
+    Wire.beginTransmission(_i2c_address);
+    Wire.write(MCP23017_IOCONA);
+    Wire.write(MCP23017_IOCON_MIRROR | MCP23017_IOCON_ODR);
     Wire.endTransmission();
 
-    // enable 100k pullups on all inputs...
-    Wire.beginTransmission(i2caddr);
-    Wire.write(MCP23017_GPPUA);
-    Wire.write(0xff & dir);         // Low byte
+    // Only input pins generate interrupts, on any change from the previous pin value
+    Wire.beginTransmission(_i2c_address);
+    Wire.write(MCP23017_GPINTENA);
+    Wire.write(0xff & _config);         // GPINTENA
+    Wire.write(0xff & (_config >> 8));  // GPINTENB
+    Wire.write(0x00);                   // DEFVALA (unused)
+    Wire.write(0x00);                   // DEFVALB (unused)
+    Wire.write(0x00);                   // INTCONA - compare against previous value
+    Wire.write(0x00);                   // INTCONB
     Wire.endTransmission();
 
-    Wire.beginTransmission(i2caddr);
-    Wire.write(MCP23017_GPPUB);
-    Wire.write(0xff & (dir >> 8));  // High byte
-    Wire.endTransmission();
+    _intpin   = intPin;
+    _intstale = true;   // next read() picks up the current pin state and clears anything pending
 }
 
-
 uint32_t I2Cexpander::read23017() {
     uint32_t data = 0;
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(MCP23017_GPIOA);
-    Wire.endTransmission();
-
-    Wire.requestFrom(_i2c_address, (uint8_t)2, (uint8_t)1);
-    data = Wire.read();
-    data |= (Wire.read() << 8);
+    if (_intpin >= 0) {
+        if (!_intstale && (::digitalRead(_intpin) == HIGH)) {
+            return _current;    // INT not asserted - nothing changed, no bus traffic needed
+        }
+        // INTFA, INTFB, INTCAPA, INTCAPB, GPIOA, GPIOB in one sequential read
+        _status = I2Cchip::pointAt(_i2c_address, MCP23017_INTFA, false);   // repeated start
+        if (!I2Cchip::ok(_status)) {
+            return _current;
+        }
+        return fetch23017int();
+    }
+    _status = I2Cchip::MCP23017::read(_i2c_address, _config, data);
+    if (_status != 0) {
+        return (_current);
+    }
     return data;
 }
 
+uint32_t I2Cexpander::fetch23017int(void) {
+    _status = 0;
+    if (Wire.requestFrom(_i2c_address, (uint8_t)6, (uint8_t)1) != 6) {
+        _status = STATUS_ADDR_NACK;
+        return _current;
+    }
+    uint16_t intf = Wire.read();
+    intf         |= (Wire.read() << 8);
+    uint16_t cap  = Wire.read();
+    cap          |= (Wire.read() << 8);
+    uint32_t data = Wire.read();
+    data         |= (Wire.read() << 8);
+
+    // Report the captured value for pins that interrupted, so that a pulse shorter
+    // than the scan period is still seen.  If the pin has already moved on, the
+    // interrupt for that second edge was cleared by this read, so poll again next time.
+    _intstale = ((cap ^ data) & intf) != 0;
+    return (data & ~(uint32_t)intf) | (cap & intf);
+}
+
 void I2Cexpander::write23017(uint32_t data) {
-    data = data | _config;
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(MCP23017_GPIOA);
-    Wire.write(0xff & data);  //  low byte
-    Wire.write(data >> 8);    //  high byte
-    Wire.endTransmission();
+    uint16_t diff = (_policy & ELIDE_PARTIAL) && _wvalid ? (data ^ _lastw) & ~_config : 0xFFFF;
+    _status = I2Cchip::MCP23017::write(_i2c_address, _config, data, diff);
 }
 
 /*
@@ -486,54 +1044,29 @@ void I2Cexpander::write23017(uint32_t data) {
  */
 
 void I2Cexpander::init9555(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < base9555) {
-        a = base9555 + i2caddr;
-    } else {
-        a = i2caddr;
-    }
-    I2Cexpander::init9555_compat(a, dir);
+    I2Cexpander::init9555_compat(I2Cchip::PCA9555::address(i2caddr), dir);
 }
 void I2Cexpander::init23016(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < base23016) {
-        a = base23016 + i2caddr;
-    } else {
-        a = i2caddr;
-    }
-    I2Cexpander::init9555_compat(a, dir);
+    I2Cexpander::init9555_compat(I2Cchip::MCP23016::address(i2caddr), dir);
 }
 
 void I2Cexpander::init9555_compat(uint8_t i2caddr, uint16_t dir) {
     _i2c_address = i2caddr;
-    Wire.beginTransmission(i2caddr);
-    Wire.write(PCA9555_CONFIG);
-    Wire.write(0xff & dir);  // low byte
-    Wire.write(dir >> 8);    // high byte
-    Wire.endTransmission();  
+    I2Cchip::PCA9555::init(i2caddr, dir);
 }
 
 uint32_t I2Cexpander::read9555() {
     uint32_t data = 0;
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(PCA9555_INPUT);
-    int n = Wire.endTransmission(false);  
-    if (! ((n == 0) || (n ==7)) ) {
-		return (_last);
+    _status = I2Cchip::PCA9555::read(_i2c_address, _config, data);
+    if (_status != 0) {
+		return (_current);
     }
-    Wire.requestFrom(_i2c_address, (uint8_t)2, (uint8_t)1);
-    data = Wire.read();
-    data |= (Wire.read() << 8);  
     return data;
 }
 
 void I2Cexpander::write9555(uint32_t data) {
-    data = data | _config;
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(PCA9555_OUTPUT);
-    Wire.write(0xff & data);  //  low byte
-    Wire.write(data >> 8);    //  high byte
-    Wire.endTransmission();  
+    uint16_t diff = (_policy & ELIDE_PARTIAL) && _wvalid ? (data ^ _lastw) & ~_config : 0xFFFF;
+    _status = I2Cchip::PCA9555::write(_i2c_address, _config, data, diff);
 }
 
 
@@ -546,40 +1079,9 @@ void I2Cexpander::write9555(uint32_t data) {
  */
 
 void I2Cexpander::init731x(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < 0x20) {
-        a = (i2caddr < 0x20) ? base731x + i2caddr : base731x + 0x30 + i2caddr;
-    } else a = i2caddr;
-
-    I2Cexpander::init9555_compat(a, dir);
-    
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0x0F);  // Config
-    Wire.write(0x08);  //  No Global Brightness
-    Wire.endTransmission();  
-	/*
-	 // alternative for PWM stuff...
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0x0E);  // O16 config, master brightness
-	Wire.write(0xFF);  
-    Wire.endTransmission();  
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0x02);  // Blink Phase 0 -  specify each output’s logic level during the PWM on-time
-    Wire.write(0xFF);  //  
-    Wire.write(0xFF);  //  
-    Wire.endTransmission();  
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0x10);  // P0/P1 dimmer
-    Wire.write(0xFF);  // P0/P1 = 00001111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.write(0xFF);  // P2/P3 = 11111111
-    Wire.endTransmission();  
-	*/
+    _i2c_address = I2Cchip::MAX731x::address(i2caddr);
+    I2Cchip::MAX731x::init(_i2c_address, dir);
+    // blink phase 1 and the PWM intensity engine are managed by I2Cblink
 }
 
 
@@ -590,60 +1092,23 @@ void I2Cexpander::init731x(uint8_t i2caddr, uint16_t dir) {
  */
 
 void I2Cexpander::init9685(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < base9685) {
-        a = i2caddr + base9685;
-    } else {
-        a = i2caddr;
-    }
-    _i2c_address = a;
-	Wire.beginTransmission(_i2c_address);
-    Wire.write(PCA9685_MODE1);
-    Wire.write(PCA9685_MODE1_RESTART | PCA9685_MODE1_AUTOINC | PCA9685_MODE1_ALLCALL);
-    Wire.endTransmission();  
-    delay(1);
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(PCA9685_MODE2);
-    Wire.write(PCA9685_MODE2_TOTEM | PCA9685_MODE2_OEOFF);
-    Wire.endTransmission();  
-    delay(1);
+    _i2c_address = I2Cchip::PCA9685::address(i2caddr);
+    I2Cchip::PCA9685::init(_i2c_address, dir);
 }
 
 // read uses the config value to distinguish which LED to read/write
 
 uint32_t I2Cexpander::read9685() {
     uint32_t data = 0;
-    uint16_t startdata = 0;
-    uint16_t stopdata = 0;
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(PCA9685_BASE_LED0 + (_config * 4));
-    int n = Wire.endTransmission(false);  
-    if (! ((n == 0) || (n ==7)) ) {
-		return (_last);
+    _status = I2Cchip::PCA9685::read(_i2c_address, _config, data);
+    if (_status != 0) {
+		return (_current);
     }
-    Wire.requestFrom(_i2c_address, (uint8_t)4, (uint8_t)1);
-    startdata = Wire.read();
-    startdata |= (Wire.read() << 8);  
-    stopdata = Wire.read();
-    stopdata |= (Wire.read() << 8);  
-	if (stopdata == startdata)     data = 0;
-	else if (stopdata < startdata) data = startdata + stopdata & 0x0FFF;
-	else                           data = stopdata - startdata;
     return data;
 }
 
 void I2Cexpander::write9685(uint32_t data) {
-    data = data & 0x0FFF;		// 12 bits
-    int b1 = (data     ) & 0x00FF; // low
-    int b2 = (data >> 8) & 0x00FF; // and high bits
-	// TODO: Stagger starting phase to ensure each string is independent, to reduce power supply spiking
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(PCA9685_BASE_LED0 + (_config * 4));
-    Wire.write(0x00);  
-    Wire.write(0x00);  
-    Wire.write(b1);  
-    Wire.write(b2);  
-    Wire.endTransmission();  
+    _status = I2Cchip::PCA9685::write(_i2c_address, _config, data);
 }
 
 /*
@@ -653,36 +1118,16 @@ void I2Cexpander::write9685(uint32_t data) {
  */
 
 void I2Cexpander::init8591(uint8_t i2caddr, uint16_t dir) {
-    uint8_t a;
-    if (i2caddr < base8591) {
-        a = base8591 + i2caddr;
-    } else {
-        a = i2caddr;
-    }
-    _i2c_address = a;
+    _i2c_address = I2Cchip::PCF8591::address(i2caddr);
 }
 
 uint32_t I2Cexpander::read8591() {
-	uint32_t result;
-	uint32_t result1;
-	uint32_t result2;
-	uint32_t result3;
-	uint32_t result4;
-	
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0x04);
-    Wire.endTransmission();
-    Wire.requestFrom(_i2c_address, (uint8_t)5);
-
-    Wire.read(); // ignore the Analog Output value
-
-    result1 = Wire.read();
-    result2 = Wire.read();
-    result3 = Wire.read();
-    result4 = Wire.read(); 
-
-    result = ((result4 & 0xFF) << 24) | ((result3 & 0xFF) << 16) | ((result2 & 0xFF) << 8) | ((result1 & 0xFF) << 0);
-    return result;
+    uint32_t data = 0;
+    _status = I2Cchip::PCF8591::read(_i2c_address, _config, data);
+    if (_status != 0) {
+		return (_current);
+    }
+    return data;
 }
 	
 uint32_t I2Cexpander::Xread8591() {
@@ -721,10 +1166,7 @@ uint32_t I2Cexpander::Xread8591() {
 }
 
 void I2Cexpander::write8591(uint32_t data) {
-    Wire.beginTransmission(_i2c_address);
-    Wire.write(0x40);
-    Wire.write(0xff & data);
-    Wire.endTransmission();  
+    _status = I2Cchip::PCF8591::write(_i2c_address, _config, data);
 }
 
 /*
@@ -796,7 +1238,27 @@ void I2Cexpander::initArduino(void) {   //                             INIT
 uint32_t I2Cexpander::readArduino(void) {   //                         READ
     uint32_t data = 0;
     switch (_chip) {
-
+#if defined(I2C_EXTENDER_PORTIO_328)
+    //          bit 0    bit 1    bit 2    bit 3
+    // ARDIO_A  D2 PD2   D3 PD3   D4 PD4   D5 PD5
+    // ARDIO_B  D6 PD6   D9 PB1   D10 PB2  D11 PB3
+    // ARDIO_C  D12 PB4  D13 PB5  A0 PC0   A1 PC1
+    // ARDIO_D  A2 PC2   A3 PC3   A6 -     A7 -
+    case I2Cexpander::ARDIO_A:
+        data = (PIND >> 2) & 0x0F;
+    break;
+    case I2Cexpander::ARDIO_B:
+        data = ((PIND >> 6) & 0x01) | (PINB & 0x0E);
+    break;
+    case I2Cexpander::ARDIO_C:
+        data = ((PINB >> 4) & 0x03) | ((PINC & 0x03) << 2);
+    break;
+    case I2Cexpander::ARDIO_D:
+        data = (PINC >> 2) & 0x03;
+        bitWrite(data,2, (analogRead(A6) > 100) ? 1 : 0);
+        bitWrite(data,3, (analogRead(A7) > 100) ? 1 : 0);
+    break;
+#else
     case I2Cexpander::ARDIO_A:        
         bitWrite(data,0,::digitalRead(2));
         bitWrite(data,1,::digitalRead(3));
@@ -821,6 +1283,7 @@ uint32_t I2Cexpander::readArduino(void) {   //                         READ
         bitWrite(data,2, (analogRead(A6) > 100) ? 1 : 0);
         bitWrite(data,3, (analogRead(A7) > 100) ? 1 : 0);
     break;
+#endif
 
     default: break;
     }
@@ -828,6 +1291,32 @@ return data;
 }
 
 void I2Cexpander::writeArduino(uint32_t data) { //             WRITE
+#if defined(I2C_EXTENDER_PORTIO_328)
+    uint8_t out = ~_config;     // only touch output pins
+#ifdef I2C_EXTENDER_INVERTLOCAL
+    data = ~data;
+#endif
+    switch (_chip) {
+    case I2Cexpander::ARDIO_A:
+        portWrite(&PORTD, (out & 0x0F) << 2, data << 2);
+    break;
+    case I2Cexpander::ARDIO_B:
+        portWrite(&PORTD, (out & 0x01) << 6, data << 6);
+        portWrite(&PORTB, (out & 0x0E),      data);
+    break;
+    case I2Cexpander::ARDIO_C:
+        portWrite(&PORTB, (out & 0x03) << 4, data << 4);
+        portWrite(&PORTC, (out & 0x0C) >> 2, data >> 2);
+    break;
+    case I2Cexpander::ARDIO_D:
+        portWrite(&PORTC, (out & 0x03) << 2, data << 2);
+        //      A6 and 
+        //      A7 are input-only analog pins
+    break;
+
+    default: break;
+    }
+#else
     switch (_chip) {
     case I2Cexpander::ARDIO_A:        
          writeif( 2, data, 0);
@@ -856,6 +1345,7 @@ void I2Cexpander::writeArduino(uint32_t data) { //             WRITE
 
     default: break;
     }
+#endif
 }
 #endif
 
@@ -1090,6 +1580,26 @@ void I2Cexpander::initBBLeo(void) {   //                             INIT
 
 uint32_t    I2Cexpander::readBBLeo(void) {  //                        READ
     uint32_t data = 0;
+#if defined(I2C_EXTENDER_PORTIO_32U4)
+    //              bit 0    bit 1    bit 2    bit 3    bit 4    bit 5    bit 6    bit 7
+    // CPNODE_LOW   D4 PD4   D5 PC6   D6 PD7   D7 PE6   D8 PB4   D9 PB5   D10 PB6  D11 PB7
+    // CPNODE_HIGH  D12 PD6  D13 PC7  A0 PF7   A1 PF6   A2 PF5   A3 PF4   A4 PF1   A5 PF0
+    uint8_t d = PIND;
+    uint8_t c = PINC;
+    switch (_chip) {
+    case I2Cexpander::CPNODE_LOW:
+        data = ((d >> 4) & 0x01) | ((c >> 5) & 0x02) | ((d >> 5) & 0x04) | ((PINE >> 3) & 0x08) | (PINB & 0xF0);
+    break;
+    case I2Cexpander::CPNODE_HIGH: {
+        uint8_t f = PINF;
+        data = ((d >> 6) & 0x01) | ((c >> 6) & 0x02)
+             | ((f >> 5) & 0x04) | ((f >> 3) & 0x08) | ((f >> 1) & 0x10) | ((f << 1) & 0x20)
+             | ((f << 5) & 0x40) | ((f << 7) & 0x80);
+    }
+    break;
+    default: break;
+    }
+#else
     switch (_chip) {
     case I2Cexpander::CPNODE_LOW:
         bitWrite(data, 0,::digitalRead( 4));
@@ -1113,10 +1623,37 @@ uint32_t    I2Cexpander::readBBLeo(void) {  //                        READ
     break;
     default: break;
     }
+#endif
     return data;
 }
 
 void I2Cexpander::writeBBLeo(uint32_t data) { //                   WRITE
+#if defined(I2C_EXTENDER_PORTIO_32U4)
+    uint8_t out = ~_config;     // only touch output pins
+#ifdef I2C_EXTENDER_INVERTLOCAL
+    data = ~data;
+#endif
+    switch (_chip) {
+    case I2Cexpander::CPNODE_LOW:
+        portWrite(&PORTD, ((out & 0x01) << 4) | ((out & 0x04) << 5), ((data & 0x01) << 4) | ((data & 0x04) << 5));
+        portWrite(&PORTC,  (out & 0x02) << 5,                          (data & 0x02) << 5);
+        portWrite(&PORTE,  (out & 0x08) << 3,                          (data & 0x08) << 3);
+        portWrite(&PORTB,  (out & 0xF0),                                data);
+    break;
+    case I2Cexpander::CPNODE_HIGH: {
+        portWrite(&PORTD,  (out & 0x01) << 6,                          (data & 0x01) << 6);
+        portWrite(&PORTC,  (out & 0x02) << 6,                          (data & 0x02) << 6);
+        // A0..A3 are PF7..PF4 (reversed), A4, A5 are PF1, PF0
+        uint8_t fo = ((out  & 0x04) << 5) | ((out  & 0x08) << 3) | ((out  & 0x10) << 1) | ((out  & 0x20) >> 1)
+                   | ((out  & 0x40) >> 5) | ((out  & 0x80) >> 7);
+        uint8_t fd = ((data & 0x04) << 5) | ((data & 0x08) << 3) | ((data & 0x10) << 1) | ((data & 0x20) >> 1)
+                   | ((data & 0x40) >> 5) | ((data & 0x80) >> 7);
+        portWrite(&PORTF, fo, fd);
+    }
+    break;
+    default: break;
+    }
+#else
     switch (_chip) {
     case I2Cexpander::CPNODE_LOW:
         writeif( 4, data, 0);
@@ -1140,6 +1677,7 @@ void I2Cexpander::writeBBLeo(uint32_t data) { //                   WRITE
     break;
     default: break;
     }
+#endif
 }
 #endif
 
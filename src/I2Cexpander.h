@@ -39,6 +39,54 @@
 
 #endif
 
+/**
+ * The largest transaction (register pointer + data) the platform's Wire library can buffer.
+ * Bulk writes are chunked to fit.
+ */
+#ifndef I2C_EXPANDER_BUFFER
+#if defined(I2C_BUFFER_LENGTH)
+#define I2C_EXPANDER_BUFFER I2C_BUFFER_LENGTH
+#elif defined(BUFFER_LENGTH)
+#define I2C_EXPANDER_BUFFER BUFFER_LENGTH
+#else
+#define I2C_EXPANDER_BUFFER 32
+#endif
+#endif
+
+/**
+ * Per-device transaction counters and a bus utilization meter.
+ * Uncomment (or add -DI2C_EXPANDER_STATS to the build flags) to enable;
+ * without it, none of the stats code or data is compiled in.
+ */
+// #define I2C_EXPANDER_STATS
+
+class I2Cdebounce;
+
+#ifdef I2C_EXPANDER_STATS
+/**
+ * What one device has been doing on the bus, see I2Cexpander::stats()
+ */
+struct I2CexpanderStats {
+    uint32_t reads;             ///< read transactions
+    uint32_t writes;            ///< write transactions
+    uint16_t errors[6];         ///< failed transactions by Wire status: [1] too long, [2] address NACK, [3] data NACK, [4] other, [5] timeout
+    uint8_t  lastError;         ///< the most recent failing Wire status
+    uint16_t retries;           ///< debounced reads that still had bits settling
+    uint16_t minMicros;         ///< fastest transaction
+    uint16_t maxMicros;         ///< slowest transaction
+    uint32_t totalMicros;       ///< time spent in all of them
+
+    /**
+     * @return address and data NACKs
+     */
+    uint16_t nacks(void) const      { return errors[2] + errors[3]; };
+    /**
+     * @return mean transaction time in micros
+     */
+    uint16_t avgMicros(void) const  { return (reads + writes) ? totalMicros / (reads + writes) : 0; };
+};
+#endif
+
 /**
  * A collection of I2C expanders with a simple API:
  *    init()
@@ -104,6 +152,43 @@ public:
 
     };
 
+    /** Bus clock speeds, see setClock(). */
+    enum Clock {
+      CLOCK_100K    =  100000UL,    ///< Standard-mode
+      CLOCK_400K    =  400000UL,    ///< Fast-mode
+      CLOCK_1M      = 1000000UL     ///< Fast-mode Plus
+    };
+
+    /** Transaction elision policy bits, see policy(). */
+    enum Policy {
+      ELIDE_NONE    = 0x00,     ///< Every read() and write() goes to the device (default)
+      ELIDE_WRITES  = 0x01,     ///< Skip writes that would not change the device's output latch
+      ELIDE_READS   = 0x02,     ///< Answer reads of all-output devices from the write cache
+      ELIDE_PARTIAL = 0x04,     ///< 16-bit expanders: only write the port byte that changed
+      ELIDE_ALL     = 0x07,     ///< All of the above
+      DEFER_WRITES  = 0x08,     ///< digitalWrite() and put() only update next; commit() writes it
+      CACHE_READS   = 0x10      ///< digitalRead() answers from current() if it was read this epoch, see refresh()
+    };
+
+    /** status() values: 0 and the Wire endTransmission() codes, plus... */
+    enum Status {
+      STATUS_OK          = 0x00,    ///< success
+      STATUS_TOO_LONG    = 0x01,    ///< data too long for the Wire buffer
+      STATUS_ADDR_NACK   = 0x02,    ///< NACK on the address (device missing, or a short read)
+      STATUS_DATA_NACK   = 0x03,    ///< NACK on a data byte
+      STATUS_OTHER       = 0x04,    ///< other bus error
+      STATUS_TIMEOUT     = 0x05,    ///< bus timeout (newer Wire libraries)
+      STATUS_QUARANTINED = 0xFE,    ///< skipped, the device is quarantined
+      STATUS_IDLE        = 0xFF     ///< answered without a bus transaction (cache, MCU pins, INT not asserted)
+    };
+
+    /** health() values */
+    enum Health {
+      HEALTHY     = 0,      ///< the last operation succeeded
+      DEGRADED    = 1,      ///< failing, but not (yet) enough times in a row to be quarantined
+      QUARANTINED = 2       ///< left alone except for an occasional re-probe
+    };
+
     /*!
         @brief  I2Cexpander class Constructor.
                 No arguments so that it can be either statically initialized OR dynamic.
@@ -125,7 +210,7 @@ public:
                   or a virtual name for the onboard MCU pins [ARDIO_A, WEMOS_C, ...]
                   The special type "IGNORE" can be used to document I2C addresses used elsewhere.
         @param    debounce
-                  For bit-I/O, ensure that 2x readings are the same before noting a pin change.
+                  For bit-I/O, ensure that 2x consecutive readings are the same before noting a pin change.
      */
     I2Cexpander(ExpanderType device_type, size_t address, boolean debounce=false);
 
@@ -148,7 +233,8 @@ public:
                   Usually, the Input-vs-Output pin direction settings, used on a device-by-device basis
                   for device specific configuration.
         @param    debounce
-                  For bit-I/O, ensure that 2x readings are the same before noting a pin change.
+                  For bit-I/O, ensure that 2x consecutive readings are the same before noting a pin change.
+                  (see debounce(I2Cdebounce *) for deeper or time based filtering)
     */
     void     init(size_t address, uint16_t device_type, uint16_t config, boolean debounce=false);
 
@@ -162,9 +248,31 @@ public:
     */
     void     init(uint16_t config);
 
+    /*!
+        @brief  MCP23017 only: Use the chip's interrupt-on-change logic instead of polling.
+                Change interrupts are enabled on every input pin (the "1" bits in config),
+                and INTA/INTB are mirrored and open-drain so that several chips can share one INT line.
+                After this, read() only touches the bus when the INT line is asserted, and
+                returns the captured (INTCAP) value for pins that changed, so short pulses are not lost.
+                Call after init().
+        @param    intPin
+                  The MCU pin wired to the (active LOW) INT line.
+    */
+    void     interruptMode(uint8_t intPin);
+
+    /*!
+        @brief  Filter read() data through a debounce engine with per-bit depth and timing.
+                read() never re-reads the device; each call feeds one sample to the filter.
+                Call after init().
+        @param    engine
+                  the filter state for this device, or NULL to turn debouncing off
+    */
+    void     debounce(I2Cdebounce *engine);
+
     /*!
         @brief  Arduino compatibility routine.
-                Write a bit to an expander.  Updates current cached state and writes data to the device.
+                Write a bit to an expander.  Updates current cached state and writes data to the device
+                (with the DEFER_WRITES policy, only marks it dirty() until commit()).
         @param    dataPin
                   which bit in the I/O device's control [0..7 or 0..15, etc].
         @param    val
@@ -173,7 +281,9 @@ public:
     void     digitalWrite(uint8_t dataPin, uint8_t val);
     /*!
         @brief  Arduino compatibility routine.
-                Read from an expander, update the cached state and return the bit value
+                Read from an expander, update the cached state and return the bit value.
+                With the CACHE_READS policy, a device that has already been read since the
+                last refresh() isn't read again.
         @param    dataPin
                   which bit in the I/O device's control [0..7 or 0..15, etc].
         @return  the value of the bit - HIGH, 1 or LOW, 0
@@ -186,6 +296,24 @@ public:
     */
     uint32_t read(void);
 
+    /*!
+        @brief  Start a non-blocking read().  Nothing goes on the bus until poll().
+    */
+    void     beginRead(void)    { _step = STEP_START; _tries = 0; };
+    /*!
+        @brief  Run the next step of a read started by beginRead() - at most one bus
+                transaction: a mux select, a register pointer write, or the data fetch.
+                When the last step finishes, the data lands in current()/last() just as
+                read() would have left it, so changed() keeps working.
+        @return TRUE when the read is done
+    */
+    bool     poll(void);
+    /*!
+        @brief  Is the read started by beginRead() finished?
+        @return TRUE if no read is in progress
+    */
+    bool     done(void)         { return _step == STEP_IDLE; };
+
     /*!
         @brief  wrapper for read().
         @return  the data from the device (1,4,8, 16 or 32 bits, per the device type)
@@ -202,11 +330,22 @@ public:
         @param data
                 (1,4,8, 16 or 32 bits, per the device type)
     */
-    void     put(uint32_t data) { next = data; I2Cexpander::write(next); }
+    void     put(uint32_t data) { next = data; I2Cexpander::put(); }
     /*!
-        @brief  wrapper for write(this->next).
+        @brief  wrapper for write(this->next), or with the DEFER_WRITES policy, mark it dirty() for commit().
+    */
+    void     put(void)          { if (_policy & DEFER_WRITES) _dirty = true; else I2Cexpander::write(next); }
+    /*!
+        @brief  DEFER_WRITES policy: write next to the device if digitalWrite() or put() changed it
+                since the last commit().  However many bits were set, that is one write().
+        @return TRUE if there was something to write
+    */
+    bool     commit(void);
+    /*!
+        @brief  Is there a deferred write waiting for commit()?
+        @return TRUE if there is
     */
-    void     put(void)          { I2Cexpander::write(next);   }
+    bool     dirty()            { return I2Cexpander::_dirty; };
     /*!
         @brief  wrapper for write(this->next).
     */    void     write(void)        { I2Cexpander::write(next);   }
@@ -246,11 +385,225 @@ public:
     */
     uint8_t  i2caddr()          { return I2Cexpander::_i2c_address; };
 
+    /*!
+        @brief  Address a device behind a TCA9548A/PCA9548 I2C mux.  Pass the result to init()
+                in place of the device's address:
+                <pre>
+                m[x].init(I2Cexpander::muxed(1, 3, 1), I2Cexpander::PCF8574, 0xFF); // 8574 #1 on channel 3 of the mux at 0x71
+                </pre>
+                A mux at 0x70 shares the PCA9685 ALLCALL address, which init() enables: with
+                PCA9685s on the bus, put the muxes at 0x71-0x77.
+        @param    mux
+                  Either a zero-based mux sequence number [0..7] OR its real I2C address [0x70..0x77]
+        @param    channel
+                  [0..7]
+        @param    address
+                  The device's address, as init() takes it
+        @return an init() address that includes the mux route
+    */
+    static size_t muxed(uint8_t mux, uint8_t channel, size_t address) {
+        return MUX_ROUTED | ((size_t)(mux & 0x07) << 11) | ((size_t)(channel & 0x07) << 8) | (address & 0xFF);
+    };
+    /*!
+        @brief  The mux a muxed() address goes through
+        @param    address
+                  an init() address
+        @return the mux's I2C address, 0 if the address isn't routed
+    */
+    static uint8_t muxOf(size_t address)        { return (address & MUX_ROUTED) ? baseMux + ((address >> 11) & 0x07) : 0; };
+    /*!
+        @brief  ...and which of its channels
+        @param    address
+                  an init() address
+        @return [0..7]
+    */
+    static uint8_t channelOf(size_t address)    { return (address >> 8) & 0x07; };
+    /*!
+        @brief  Open the mux channel a device is behind, unless it already is, closing another
+                mux's open channel first.  I2Cexpander does this itself; the whole-chip drivers
+                (I2Cpwm, I2Cadda, I2Cblink) call it so that they share the remembered channel.
+        @param    mux
+                  the mux's I2C address, 0 if the device is directly on the bus
+        @param    channel
+                  [0..7]
+        @return STATUS_OK, or the Wire error of the control byte
+    */
+    static uint8_t route(uint8_t mux, uint8_t channel);
+    /*!
+        @brief  I2C mux route
+        @return the I2C address of the mux this device is behind, 0 if it is directly on the bus
+    */
+    uint8_t  muxaddr()          { return I2Cexpander::_mux; };
+    /*!
+        @brief  I2C mux route
+        @return the mux channel this device is on
+    */
+    uint8_t  muxchannel()       { return I2Cexpander::_channel; };
+    /*!
+        @brief  Forget which mux channel is selected, so the next muxed access re-sends the control byte.
+                Use after anything other than I2Cexpander has written to a mux, or after a mux reset.
+    */
+    static void muxReset(void)  { _muxSelected = 0; _muxChannel = 0; };
+    /*!
+        @brief  Note that something other than I2Cexpander has closed every channel of a mux.
+                If it had the open channel, the next muxed access re-sends the control byte;
+                a channel left open on another mux is still remembered, and closed when needed.
+        @param    mux
+                  the mux's I2C address
+    */
+    static void muxClosed(uint8_t mux)  { if (_muxSelected == mux) muxReset(); };
+
+    /*!
+        @brief  Set the bus clock used when talking to this device (400kHz by default).
+                A slow or long-cabled board can run at 100kHz while the rest of the bus
+                runs faster; Fast-mode Plus (1MHz) is only used with chips that support it
+                (PCA9685, MCP23017) and that are not behind a mux.
+        @param    hz
+                  CLOCK_100K, CLOCK_400K, CLOCK_1M, or anything in between
+    */
+    void     setClock(uint32_t hz);
+    /*!
+        @brief  Bus clock used for this device
+        @return Hz
+    */
+    uint32_t getClock()         { return I2Cexpander::_clock * 100000UL; };
+    /*!
+        @brief  Forget the bus clock setting, so the next access calls Wire.setClock().
+                Use after anything other than I2Cexpander has called Wire.setClock().
+    */
+    static void clockReset(void) { _busClock = 0; };
+    /*!
+        @brief  Switch the bus clock, unless it is already there.  I2Cexpander does this
+                itself; the whole-chip drivers (I2Cpwm, I2Cadda, I2Cblink) call it so that
+                a faster device on the same bus can't leave them overclocked.
+        @param    clock
+                  100kHz units, 0 to leave the bus alone
+    */
+    static void useClock(uint8_t clock) { if (clock && (clock != _busClock)) { Wire.setClock(clock * 100000UL); _busClock = clock; } };
+
+    /*!
+        @brief  Set the transaction elision policy.  The default, ELIDE_NONE, puts every
+                read and write on the bus as the library always has; policy(ELIDE_ALL) skips
+                the redundant ones.  Go back to ELIDE_NONE to force a refresh of a device
+                that may have been power cycled.
+        @param    p
+                  ELIDE_* bits OR'd together
+    */
+    void     policy(uint8_t p)  { I2Cexpander::_policy = p; };
+    /*!
+        @brief  Transaction elision policy
+        @return the ELIDE_* bits in effect
+    */
+    uint8_t  policy()           { return I2Cexpander::_policy; };
+    /*!
+        @brief  Start a new read epoch: CACHE_READS devices are read again by their next digitalRead().
+                ExpanderBus::scan() and beginScan() do this for you.
+    */
+    static void refresh(void);
+    /*!
+        @brief  Limit how long a read epoch lasts, so CACHE_READS data is never older than this
+                even without refresh() calls.
+        @param    us
+                  microseconds, 0 (default) for no limit
+    */
+    static void freshness(uint32_t us) { _freshness = us; };
+    /*!
+        @brief  How many bus transactions has the elision policy avoided?
+        @return count of skipped reads and writes
+    */
+    uint16_t saved()            { return I2Cexpander::_saved; };
+
+    /*!
+        @brief  Outcome of the last read() or write().
+                A failed read() leaves current() alone, so bad data never shows up in changed().
+        @return STATUS_OK, a Wire error code, STATUS_QUARANTINED or STATUS_IDLE
+    */
+    uint8_t  status()           { return I2Cexpander::_status; };
+    /*!
+        @brief  Did the last read() or write() succeed?
+        @return TRUE unless it failed or was skipped by quarantine
+    */
+    bool     ok()               { return (_status == STATUS_OK) || (_status == STATUS_IDLE); };
+    /*!
+        @brief  Device health, from its recent history of failures
+        @return HEALTHY, DEGRADED or QUARANTINED
+    */
+    uint8_t  health()           { return I2Cexpander::_health; };
+    /*!
+        @brief  How many read()s or write()s in a row have failed?
+        @return count, reset by the first success
+    */
+    uint8_t  failures()         { return I2Cexpander::_failures; };
+
+    /*!
+        @brief  Error handling for every I2Cexpander device.
+        @param    retries
+                  extra attempts for a failed read() or write() (default 1)
+        @param    quarantineAfter
+                  consecutive failed operations before a device is quarantined, 0 for never (default 4)
+        @param    reprobeMs
+                  how often a quarantined device is probed; when it answers again it is
+                  re-initialized and its last output value rewritten (default 1000)
+    */
+    static void retryPolicy(uint8_t retries, uint8_t quarantineAfter, uint16_t reprobeMs);
+
+    /*!
+        @brief  Is anything answering at an I2C address?  (a zero-length write)
+        @param    address
+                  7-bit I2C address
+        @return Wire status, STATUS_OK if the address was ACKed
+    */
+    static uint8_t probe(uint8_t address);
+
     /*!
         @brief  Have any INPUT bits changed since the last "read()"?
         @return TRUE if something changed.
     */
     bool  changed();
+
+    /*!
+        @brief  Which INPUT bits changed in the last "read()"?  (analog devices: every bit)
+        @return bit mask
+    */
+    uint32_t toggled()          { return (_current ^ _last) & inputMask(); };
+    /*!
+        @brief  Which INPUT bits went from 0 to 1 in the last "read()"?
+        @return bit mask
+    */
+    uint32_t rising()           { return toggled() & _current; };
+    /*!
+        @brief  Which INPUT bits went from 1 to 0 in the last "read()"?
+        @return bit mask
+    */
+    uint32_t falling()          { return toggled() & ~_current; };
+
+#ifdef I2C_EXPANDER_STATS
+    /*!
+        @brief  Transaction counters for this device (only with I2C_EXPANDER_STATS)
+        @return reads, writes, errors, debounce retries and latency
+    */
+    const I2CexpanderStats &stats() { return I2Cexpander::_stats; };
+    /*!
+        @brief  Zero this device's counters
+    */
+    void     resetStats(void);
+    /*!
+        @brief  Print this device's counters on Serial
+        @param    tag
+                  printed first
+    */
+    void     printStats(const char *tag);
+    /*!
+        @brief  How busy has the bus been since busReset()?
+                Counts the time every I2Cexpander spent in bus transactions.
+        @return percent of wall clock time [0..100]
+    */
+    static uint8_t  busUtilization(void);
+    /*!
+        @brief  Start a new bus utilization measurement window
+    */
+    static void     busReset(void);
+#endif
     /**
      * collection point for bits to-be-written
      */
@@ -273,8 +626,57 @@ public:
     uint32_t _lastw;        ///< last "write"
     bool     _firsttime;    ///< private flag for changed() to force an update on first check
     boolean _debounce;      ///< should read() ensure noise-free inputs?
+    boolean _primed;        ///< has _raw been seen yet?
+    uint32_t _raw;          ///< previous unfiltered read, for the 2x sample debounce
+    I2Cdebounce *_debouncer;    ///< optional deeper debounce engine
+    boolean  _wvalid;       ///< does _lastw reflect what the device has latched?
+    uint8_t  _policy;       ///< ELIDE_* transaction elision bits
+    uint16_t _saved;        ///< bus transactions avoided by the elision policy
+    int8_t   _intpin;       ///< MCP23017 INT line MCU pin, -1 when polling
+    boolean  _intstale;     ///< MCP23017 INTCAP differed from GPIO at the last read, so read again
+    uint8_t  _status;       ///< Wire status of the last transaction, STATUS_IDLE if it didn't use the bus
+    uint8_t  _health;       ///< HEALTHY, DEGRADED or QUARANTINED
+    uint8_t  _failures;     ///< consecutive failed operations
+    uint16_t _probed;       ///< millis() of the last re-probe while quarantined
+    boolean  _pending;      ///< _lastw has not reached the device yet
+    boolean  _dirty;        ///< DEFER_WRITES: next has changed since the last commit()
+    uint32_t _stamp;        ///< _epoch of the last successful read, 0 if none
+
+    uint8_t  _step;         ///< beginRead()/poll() progress
+    uint8_t  _tries;        ///< ...and retries used
+    uint8_t  _clock;        ///< bus clock, 100kHz units; 0 for MCU pins
+    uint8_t  _mux;          ///< I2C address of the mux the device is behind, 0 if none
+    uint8_t  _channel;      ///< ...and its channel
+
+    static uint8_t  _busClock;          ///< last Wire.setClock(), 100kHz units, 0 if unknown
+    static uint8_t  _muxSelected;       ///< mux with a channel open, 0 if none
+    static uint8_t  _muxChannel;        ///< ...and which channel
 
+    static uint32_t _epoch;             ///< refresh() count, starting at 1
+    static uint32_t _epochMicros;       ///< micros() at the last refresh()
+    static uint32_t _freshness;         ///< freshness()
 
+    static uint8_t  _retries;           ///< retryPolicy()
+    static uint8_t  _quarantineAfter;
+    static uint16_t _reprobeMs;
+
+#ifdef I2C_EXPANDER_STATS
+    I2CexpanderStats _stats;
+    static uint32_t  _busBusy;      ///< micros spent in transactions, all devices
+    static uint32_t  _busSince;     ///< start of the utilization window
+
+    /**
+     * Count the transaction that just finished (if there was one)
+     * @param write     was it a write?
+     * @param start     micros() when it began
+     */
+    void     tally(boolean write, uint32_t start);
+#endif
+
+
+
+public:
+    /// Register maps and base addresses, shared with the chip drivers in I2Cchip.h
 
     /// Many I2C devices are register compatible with the 9555...
     enum PCA9555Registers {
@@ -284,6 +686,21 @@ public:
 		PCA9555_CONFIG =  6
     };
 
+    /// ...the MAX7313 adds a blink phase and a PWM intensity engine (phase 0 is PCA9555_OUTPUT)
+    enum MAX731xRegisters {
+        MAX731x_PHASE0    = 0x02,
+        MAX731x_PHASE1    = 0x0A,
+        MAX731x_MASTER    = 0x0E,   // master intensity in the high nibble, O16 intensity in the low
+        MAX731x_CONFIG    = 0x0F,
+        MAX731x_INTENSITY = 0x10,   // 8 registers, 2 pins each, P0 in the low nibble
+
+        // Configuration bits
+        MAX731x_CONFIG_BLINK  = 0x01,   // blink enable
+        MAX731x_CONFIG_FLIP   = 0x02,   // blink flip: show phase 1 instead of phase 0
+        MAX731x_CONFIG_GLOBAL = 0x04,   // every pin uses the O16 intensity
+        MAX731x_CONFIG_INT    = 0x08,   // O16 is the INT output
+    };
+
     enum MCP23017Registers {
         MCP23017_IODIRA   = 0x00,
         MCP23017_IODIRB   = 0x01,
@@ -307,6 +724,15 @@ public:
         MCP23017_GPIOB    = 0x13,
         MCP23017_OLATA    = 0x14,
         MCP23017_OLATB    = 0x15,
+
+        // IOCON bits
+        MCP23017_IOCON_BANK   = 0x80,
+        MCP23017_IOCON_MIRROR = 0x40,
+        MCP23017_IOCON_SEQOP  = 0x20,
+        MCP23017_IOCON_DISSLW = 0x10,
+        MCP23017_IOCON_HAEN   = 0x08,
+        MCP23017_IOCON_ODR    = 0x04,
+        MCP23017_IOCON_INTPOL = 0x02,
     };
 
 
@@ -349,7 +775,14 @@ public:
 	enum PCA9685Registers {
 		PCA9685_MODE1           = 0x00,
 		PCA9685_MODE2           = 0x01,
+		PCA9685_SUBADR1         = 0x02,  // I2C sub addresses, in 8-bit (address << 1) form
+		PCA9685_SUBADR2         = 0x03,
+		PCA9685_SUBADR3         = 0x04,
+		PCA9685_ALLCALLADR      = 0x05,
 		PCA9685_BASE_LED0       = 0x06,  // 4 bytes, 12 bits of LED ON: +0, +1, 12 bits of LED OFF: +2 and +3
+		PCA9685_ALL_LED         = 0xFA,  // 4 bytes, same layout as LEDn, loads every channel at once
+		PCA9685_PRE_SCALE       = 0xFE,
+		PCA9685_LED_FULL        = 0x1000, // ON or OFF "full" bit, in the 16 bit ON/OFF register pairs
 
 		// Mode 1 bits
 		PCA9685_MODE1_RESTART   = 0x80,
@@ -408,9 +841,17 @@ public:
       base8574A    = 0x38,
       base8574     = 0x20,
       base8591     = 0x48,
-	  base9685     = 0x40
+	  base9685     = 0x40,
+      baseMux      = 0x70   // TCA9548A/PCA9548 I2C mux, 8x at 0x70-0x77
+    };
+
+    /// muxed() init() addresses: bits 0-7 device address, 8-10 channel, 11-13 mux, 14 set
+    enum MuxRoute {
+      MUX_ROUTED   = 0x4000
     };
 
+private:
+
 
     /**
      * Print an item in binary: xxxxxxxx_xxxxxxxx
@@ -424,11 +865,108 @@ public:
 	 */
 	void printString(const char *tag);
 private:
+	/**
+	 * Is this a digital I/O expander whose config bits are the pin directions?
+	 * @return TRUE for the PCA9555 family, MCP230xx, PCF8574/A and MAX731x
+	 */
+	bool     isDigital(void)   { return ((_chip >= FIRSTI2C) && (_chip <= PCF8574A)) || (_chip == MAX731x); };
+	/**
+	 * @return the bits changed() and toggled() look at: every bit of an analog device, the inputs of the rest
+	 */
+	uint32_t inputMask(void)   { return ((_chip == PCF8591) || (_chip == PCA9685)) ? sizeMask() : (_config & sizeMask()); };
+	/**
+	 * Can a read be answered from the write cache?  (ELIDE_READS and all outputs)
+	 * @return TRUE if the pins can only be what was last written
+	 */
+	bool     cached(void)      { return (_policy & ELIDE_READS) && _wvalid && isDigital() && ((_config & sizeMask()) == 0); };
+	/**
+	 * @return a mask of the bits this device actually has
+	 */
+	uint32_t sizeMask(void)    { return (_size >= 32) ? 0xFFFFFFFFUL : ((1UL << _size) - 1); };
 	/**
 	 * underlying dispatch routine for reading an expander
 	 * @return data from device
 	 */
     uint32_t _read(void) ;
+    /**
+     * underlying dispatch routine for writing an expander
+     * @param data
+     */
+    void     _write(uint32_t data);
+    /**
+     * @return TRUE if the last transaction failed
+     */
+    bool     failed(void)      { return !ok(); };
+    /**
+     * Update health after an operation (and its retries)
+     * @return TRUE if it succeeded
+     */
+    bool     settle(void);
+    /**
+     * Quarantined: is it time to re-probe, and is the device back?
+     * If it is, re-initialize it and rewrite its outputs.
+     * @return TRUE if the device can be used
+     */
+    bool     available(void);
+    /** Steps of a beginRead()/poll() read */
+    enum AsyncStep {
+      STEP_IDLE = 0,        ///< nothing in progress
+      STEP_START,           ///< beginRead() called
+      STEP_POINT,           ///< next: register pointer write
+      STEP_FETCH            ///< next: data read
+    };
+    /**
+     * Apply the 2x sample (or I2Cdebounce) filter to a raw read
+     * @param raw
+     * @return the filtered data, also left in _current
+     */
+    uint32_t filter(uint32_t raw);
+    /**
+     * Register pointer write of an async read
+     * @return Wire status
+     */
+    uint8_t  point(void);
+    /**
+     * Data read of an async read
+     * @param data  (output)
+     * @return Wire status
+     */
+    uint8_t  fetch(uint32_t &data);
+    /**
+     * An async step failed: retry from the pointer write, or give up
+     * @return TRUE if the read is over
+     */
+    bool     fault(void);
+    /**
+     * MCP23017 in interrupt mode: read INTFA..GPIOB (after the pointer write) and merge in INTCAP
+     * @return the data, or _current if the read failed
+     */
+    uint32_t fetch23017int(void);
+    /**
+     * Get the bus ready for this device: switch to its clock, and open the mux
+     * channel it is behind, unless they already are.
+     * A different mux with a channel open is closed first, so that devices
+     * with the same address on two muxes can't both answer.
+     * @return TRUE if the device can be reached; otherwise _status holds the mux's error
+     */
+    bool     select(void)      { speed(); return (_mux == 0) || ((_mux == _muxSelected) && (_channel == _muxChannel)) || muxSelect(); };
+    /**
+     * Switch the bus to this device's clock, unless it already is
+     */
+    void     speed(void)       { useClock(_clock); };
+    /**
+     * Limit _clock to what the chip (and any mux in front of it) supports
+     */
+    void     clampClock(void);
+    /**
+     * select() when the control byte needs to be sent
+     * @return TRUE if it was ACKed
+     */
+    bool     muxSelect(void);
+    /**
+     * Re-send the chip's init() sequence to the already resolved I2C address
+     */
+    void     reinit(void);
     /**
      * only write a bit to an Arduino or Photon port if the config register allows writing to it
      * @param port
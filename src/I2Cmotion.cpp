@@ -0,0 +1,227 @@
+/*!
+   @file I2Cmotion.cpp
+
+   Motion and fade planner for PCA9685 channels driven through I2Cpwm.
+
+    <pre>
+    I2Cpwm    board;
+    I2Cmotion motion;
+    uint8_t   points[8];
+
+    setup() {
+        Wire.begin();
+        board.init(0);
+        for (int x = 0; x < 8; x++) points[x] = motion.add(board, x, CLOSED);
+        motion.budget(64);                          // bytes per update()
+    }
+    loop() {
+        if (throw7) motion.moveTo(points[7], THROWN, 200, 400);  // 200 counts/s, 400 counts/s/s
+        motion.update();
+    }
+    </pre>
+
+   Everything is integer arithmetic, with no divisions in the per-update path
+   except one to work out the braking distance of an accelerating channel.
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cmotion.h"
+
+I2Cmotion::I2Cmotion() {
+    _count  = 0;
+    _budget = 0;
+    _then   = 0;
+    _active = false;
+}
+
+uint8_t I2Cmotion::add(I2Cpwm &chip, uint8_t channel, uint16_t position) {
+    if (_count >= I2CMOTION_MAX) {
+        return NONE;
+    }
+    Axis &a   = _axis[_count];
+    a.chip    = &chip;
+    a.channel = channel;
+    a.target  = position & 0x0FFF;
+    a.written = a.target;
+    a.pos     = (int32_t)a.target << 16;
+    a.vel     = 0;
+    a.vmax    = 0;
+    a.accel   = 0;
+    a.up      = true;
+    return _count++;
+}
+
+void I2Cmotion::moveTo(uint8_t index, uint16_t target, uint16_t speed, uint16_t accel) {
+    if (index >= _count) {
+        return;
+    }
+    Axis &a  = _axis[index];
+    a.target = target & 0x0FFF;
+    if (speed == 0) {
+        a.pos = (int32_t)a.target << 16;
+        a.vel = 0;
+    }
+    a.vmax  = (uint32_t)speed * 17180;          // counts/s    -> 8.24 counts/tick (2^24 * 1.024e-3)
+    a.accel = ((uint32_t)accel * 18014) >> 10;  // counts/s/s  -> 8.24 counts/tick/tick (2^24 * 1.048576e-6)
+    if (!_active) {
+        _then   = micros();     // don't count the idle time as motion
+        _active = true;
+    }
+}
+
+void I2Cmotion::stop(uint8_t index) {
+    if (index >= _count) {
+        return;
+    }
+    Axis &a  = _axis[index];
+    a.target = position(index);
+    a.pos    = (int32_t)a.target << 16;
+    a.vel    = 0;
+}
+
+bool I2Cmotion::moving(uint8_t index) {
+    if (index >= _count) {
+        return false;
+    }
+    const Axis &a = _axis[index];
+    return (a.pos != ((int32_t)a.target << 16)) || (a.written != a.target);
+}
+
+uint32_t I2Cmotion::braking(const Axis &a) {
+    // v^2 / 2a, as (time to stop) * (average speed)
+    uint32_t ticks = a.vel / a.accel;
+    uint32_t half  = (a.vel >> 9) + 1;          // half the speed, 16.16 counts/tick
+    if (ticks > 0xFFFFFFFFUL / half) {
+        return 0xFFFFFFFFUL;
+    }
+    return ticks * half;
+}
+
+void I2Cmotion::plan(Axis &a, uint8_t dt) {
+    int32_t goal = (int32_t)a.target << 16;
+    if ((a.pos == goal) && (a.vel == 0)) {
+        return;
+    }
+    bool     toward = (goal > a.pos);
+    uint32_t d      = toward ? (uint32_t)(goal - a.pos) : (uint32_t)(a.pos - goal);
+
+    if (a.accel == 0) {
+        a.vel = a.vmax;
+        a.up  = toward;
+    } else {
+        if (a.vel == 0) {
+            a.up = toward;
+        }
+        uint32_t dv = a.accel * dt;
+        if ((a.up != toward) || (braking(a) >= d)) {
+            a.vel = (a.vel > dv) ? a.vel - dv : 0;
+            if (a.vel == 0) {
+                a.up  = toward;         // stopped short, or reversing: creep off again
+                a.vel = a.accel;
+            }
+        } else if (a.vel < a.vmax) {
+            a.vel = ((a.vmax - a.vel) > dv) ? a.vel + dv : a.vmax;
+        }
+    }
+
+    uint32_t step = (a.vel >> 8) * dt;
+    if ((a.up == toward) && (step >= d)) {
+        a.pos = goal;                   // arrived
+        a.vel = 0;
+    } else if (a.up) {
+        // braking through a reversal can overrun the end of travel: stop there
+        if (step >= (uint32_t)(LIMIT - a.pos)) {
+            a.pos = LIMIT;
+            a.vel = 0;
+        } else {
+            a.pos += step;
+        }
+    } else {
+        if (step >= (uint32_t)a.pos) {
+            a.pos = 0;
+            a.vel = 0;
+        } else {
+            a.pos -= step;
+        }
+    }
+}
+
+uint16_t I2Cmotion::error(const Axis &a) {
+    uint16_t p = counts(a.pos);
+    return (p > a.written) ? p - a.written : a.written - p;
+}
+
+uint8_t I2Cmotion::update(void) {
+    uint8_t order[I2CMOTION_MAX];
+    uint8_t n = 0;
+
+    // Time: whole ticks since the last update, leaving the remainder for next time
+    uint32_t now   = micros();
+    uint32_t ticks = (now - _then) >> 10;
+    if (ticks > 0xFF) {
+        ticks = 0xFF;                   // a long stall: carry on, rather than jump
+        _then = now;
+    } else {
+        _then += ticks << 10;
+    }
+
+    // Plan every axis, and list the ones that are off from what was written, largest error first
+    _active = false;
+    for (uint8_t x = 0; x < _count; x++) {
+        plan(_axis[x], ticks);
+        if (moving(x)) {
+            _active = true;     // even if it hasn't moved a whole count since the last update()
+        }
+        uint16_t e = error(_axis[x]);
+        if (e == 0) {
+            continue;
+        }
+        uint8_t y = n++;
+        while ((y > 0) && (error(_axis[order[y - 1]]) < e)) {
+            order[y] = order[y - 1];
+            y--;
+        }
+        order[y] = x;
+    }
+
+    // Hand them to their chips while the budget lasts; a channel next to one already
+    // being written is cheap, so smaller errors may still fit after a larger one didn't
+    uint16_t spent = 0;
+    uint8_t  sent  = 0;
+    for (uint8_t y = 0; y < n; y++) {
+        Axis    &a    = _axis[order[y]];
+        uint16_t was  = a.chip->dirty();
+        uint8_t  cost = I2Cpwm::bytes(was | (1U << a.channel)) - I2Cpwm::bytes(was);
+        if (_budget && (spent + cost > _budget)) {
+            continue;
+        }
+        spent += cost;
+        a.chip->set(a.channel, counts(a.pos));
+        order[sent++] = order[y];
+    }
+
+    // Flush each chip once, from its first axis, so a chip that fails isn't retried per axis
+    uint8_t transactions = 0;
+    for (uint8_t x = 0; x < _count; x++) {
+        I2Cpwm *chip  = _axis[x].chip;
+        uint8_t first = 0;
+        while (_axis[first].chip != chip) {
+            first++;
+        }
+        if ((first == x) && chip->dirty()) {
+            transactions += chip->flush();
+        }
+    }
+    // Only what the chips ACKed counts as written; a failed channel stays dirty in
+    // its I2Cpwm, and keeps its error here, so it is sent again next time
+    for (uint8_t y = 0; y < sent; y++) {
+        Axis &a = _axis[order[y]];
+        if (!bitRead(a.chip->dirty(), a.channel)) {
+            a.written = a.chip->get(a.channel);
+        }
+    }
+    return transactions;
+}
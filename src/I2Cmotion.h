@@ -0,0 +1,189 @@
+/*!
+ * @file I2Cmotion.h
+ *
+ * Motion and fade planner for PCA9685 channels driven through I2Cpwm
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  A turnout servo that should take two seconds to throw, or a lamp that
+ *  should fade rather than snap, needs a stream of intermediate values.
+ *  I2Cmotion moves each channel toward its target with a speed limit and an
+ *  optional acceleration (a trapezoidal profile), and each update() writes
+ *  the channels that are furthest from where they should be, within a
+ *  bytes-per-update bus budget.  Channels that don't fit this time fall
+ *  further behind and so come first next time.
+ */
+
+#ifndef I2Cmotion_h
+#define I2Cmotion_h
+
+#include "I2Cpwm.h"
+
+/** Most channels one I2Cmotion can manage */
+#ifndef I2CMOTION_MAX
+#if defined(RAMEND) && (RAMEND < 0x1000)
+#define I2CMOTION_MAX       16
+#else
+#define I2CMOTION_MAX       64
+#endif
+#endif
+
+/**
+ * PCA9685 channels that move smoothly:
+ *    add()
+ *    moveTo()
+ *    budget()
+ *    update()
+ */
+class I2Cmotion {
+public:
+    /** add() couldn't find room */
+    static const uint8_t NONE = 0xFF;
+
+    /*!
+        @brief  I2Cmotion class Constructor.
+                No arguments so that it can be either statically initialized OR dynamic.
+    */
+    I2Cmotion(void);
+
+    /*!
+        @brief  Put a channel under the planner's control.  Call after the chip's init().
+        @param    chip
+                  the PCA9685
+        @param    channel
+                  which LED [0..15]
+        @param    position
+                  where it is now, 12-bit [0..4095]
+        @return the index to use with moveTo(), or NONE if I2CMOTION_MAX channels have been added
+    */
+    uint8_t  add(I2Cpwm &chip, uint8_t channel, uint16_t position);
+
+    /*!
+        @brief  Start moving a channel.  A move in progress is continued toward the new
+                target, slowing down and reversing first if need be.
+        @param    index
+                  from add()
+        @param    target
+                  12-bit [0..4095]
+        @param    speed
+                  top speed in counts per second, 0 to jump straight to the target
+        @param    accel
+                  counts per second per second, 0 to start and stop at full speed
+    */
+    void     moveTo(uint8_t index, uint16_t target, uint16_t speed, uint16_t accel = 0);
+
+    /*!
+        @brief  Stop a channel where it is now
+        @param    index
+                  from add()
+    */
+    void     stop(uint8_t index);
+
+    /*!
+        @brief  Limit the bus traffic of each update()
+        @param    bytes
+                  address, register pointer and data bytes per update(), 0 (default) for no limit.
+                  At least 6 bytes, one channel.
+    */
+    void     budget(uint16_t bytes)     { _budget = bytes; };
+
+    /*!
+        @brief  Advance every moving channel to where it should be now, and write the ones
+                with the largest error that fit in the budget.  Call every pass through loop().
+                A channel whose write fails (see I2Cpwm::status()) is not counted as written,
+                and is tried again on the next update().
+        @return the number of bus transactions used
+    */
+    uint8_t  update(void);
+
+    /*!
+        @brief  Where the planner has a channel now (which may be ahead of what was written)
+        @param    index
+                  from add()
+        @return 12-bit position
+    */
+    uint16_t position(uint8_t index)    { return counts(_axis[index].pos); };
+
+    /*!
+        @brief  The value last written to a channel, and ACKed by its chip
+        @param    index
+                  from add()
+        @return 12-bit position
+    */
+    uint16_t written(uint8_t index)     { return _axis[index].written; };
+
+    /*!
+        @brief  Is a channel still on its way (or not yet written at its target)?
+        @param    index
+                  from add()
+        @return TRUE if it is
+    */
+    bool     moving(uint8_t index);
+
+    /*!
+        @brief  Is any channel still on its way?
+        @return TRUE if one is
+    */
+    bool     moving(void)               { return _active; };
+
+    /*!
+        @brief  Number of channels added
+        @return count
+    */
+    uint8_t  count(void)                { return _count; };
+
+private:
+    /**
+     * One channel's motion.  Time is counted in ticks of 1024uS (micros() >> 10);
+     * positions are 16.16 fixed point counts, speeds and accelerations 8.24 fixed
+     * point counts per tick (per tick).
+     */
+    struct Axis {
+        I2Cpwm  *chip;
+        int32_t  pos;           ///< planned position
+        uint32_t vel;           ///< speed, always toward "up"
+        uint32_t vmax;          ///< top speed
+        uint32_t accel;         ///< 0: none
+        uint16_t target;
+        uint16_t written;       ///< last value handed to the chip
+        uint8_t  channel;
+        bool     up;            ///< direction of travel
+    };
+
+    static const int32_t LIMIT = 4095L << 16;  ///< end of travel, pos is kept in [0..LIMIT]
+
+    Axis     _axis[I2CMOTION_MAX];
+    uint8_t  _count;            ///< channels added
+    uint16_t _budget;           ///< bytes per update(), 0 for no limit
+    uint32_t _then;             ///< micros() of the last planning step, in whole ticks
+    bool     _active;           ///< was anything moving after the last update()?
+
+    /**
+     * Move an axis along its profile
+     * @param a     the axis
+     * @param dt    elapsed ticks
+     */
+    static void  plan(Axis &a, uint8_t dt);
+    /**
+     * How far does an axis travel while braking to a stop?
+     * @param a     the axis
+     * @return 16.16 counts, saturating
+     */
+    static uint32_t braking(const Axis &a);
+    /**
+     * Round a planned position to whole counts
+     * @param pos   16.16 counts, [0..LIMIT]
+     * @return counts
+     */
+    static uint16_t counts(int32_t pos)     { return ((uint32_t)pos + 0x8000UL) >> 16; };
+    /**
+     * How far is an axis from what was last written?
+     * @param a     the axis
+     * @return counts
+     */
+    static uint16_t error(const Axis &a);
+};
+
+#endif // I2Cmotion_h
@@ -0,0 +1,295 @@
+/*!
+   @file I2Cpwm.cpp
+
+   Whole-chip driver for the PCA9685 16 channel LED/Servo PWM controller.
+
+   Setting all 16 channels through I2Cexpander costs 16 addressed transactions;
+   with I2Cpwm the same update is 3 transactions on an AVR (7 channels fit in the
+   32 byte Wire buffer), and changing several lamps at once no longer ripples.
+
+    <pre>
+    I2Cpwm leds;
+
+    setup() {
+        Wire.begin();
+        leds.init(0);               // 0x40
+    }
+    loop() {
+        leds.set(0, 4095);          // as many set()'s as needed...
+        leds.set(1, 0);
+        leds.flush();               // ...and then one bus update
+    }
+    </pre>
+
+   Several chips can also be written at once with an I2CpwmGroup, using the
+   PCA9685's ALLCALL or SUBADR1..3 group addresses:
+
+    <pre>
+    I2Cpwm      board[12];
+    I2CpwmGroup everyone;
+
+    setup() {
+        ...init each board...
+        everyone.init(I2CpwmGroup::ALLCALL);
+        for (int x = 0; x < 12; x++) everyone.add(board[x]);
+    }
+    lampTest() {
+        everyone.allOff();          // 12 chips x 16 channels, one transaction
+    }
+    </pre>
+
+   Written by John Plocher
+
+   Released under the terms of the MIT License (MIT)
+ */
+
+#include "I2Cpwm.h"
+#include "I2Cchip.h"
+
+I2Cpwm::I2Cpwm() {
+    _i2c_address = -1;
+    _mux         = 0;
+    _channel     = 0;
+    _mode1       = 0;
+    _dirty       = 0;
+    _status      = I2Cexpander::STATUS_IDLE;
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+        _on[c]  = 0;
+        _off[c] = 0;
+    }
+}
+
+void I2Cpwm::init(size_t address) {
+    _mux         = I2Cexpander::muxOf(address);
+    _channel     = I2Cexpander::channelOf(address);
+    _i2c_address = I2Cchip::PCA9685::address(address & 0xFF);
+    if (select()) {
+        _status  = I2Cchip::PCA9685::init(_i2c_address, 0);
+    }
+    _mode1       = I2Cexpander::PCA9685_MODE1_AUTOINC | I2Cexpander::PCA9685_MODE1_ALLCALL;  // as init() leaves it
+
+    _dirty = 0xFFFF;    // we don't know what the chip has, so write everything on the first flush()
+}
+
+void I2Cpwm::set(uint8_t channel, uint16_t on, uint16_t off) {
+    if (channel >= CHANNELS) {
+        return;
+    }
+    if ((_on[channel] != on) || (_off[channel] != off)) {
+        _on[channel]  = on;
+        _off[channel] = off;
+        bitSet(_dirty, channel);
+    }
+}
+
+uint16_t I2Cpwm::get(uint8_t channel) {
+    if (channel >= CHANNELS) {
+        return 0;
+    }
+    return (_off[channel] - _on[channel]) & 0x0FFF;
+}
+
+uint8_t I2Cpwm::flush(void) {
+    uint8_t  transactions = 0;
+    uint8_t  first  = 0;
+    uint16_t failed = 0;
+
+    _status = I2Cexpander::STATUS_IDLE;
+    if (_dirty && !select()) {
+        return 0;           // everything stays dirty
+    }
+    while (first < CHANNELS) {
+        if (!bitRead(_dirty, first)) {
+            first++;
+            continue;
+        }
+        uint8_t last = span(_dirty, first);
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(I2Cexpander::PCA9685_BASE_LED0 + (first * 4));
+        for (uint8_t c = first; c <= last; c++) {
+            Wire.write(0xff & _on[c]);          // ON  low
+            Wire.write(0xff & (_on[c] >> 8));   // ON  high
+            Wire.write(0xff & _off[c]);         // OFF low
+            Wire.write(0xff & (_off[c] >> 8));  // OFF high
+        }
+        uint8_t status = Wire.endTransmission();
+        if (status != I2Cexpander::STATUS_OK) {
+            _status = status;
+            failed |= _dirty & (uint16_t)((2U << last) - (1U << first));   // channels first..last
+        } else if (_status == I2Cexpander::STATUS_IDLE) {
+            _status = status;
+        }
+        transactions++;
+        first = last + 1;
+    }
+    _dirty = failed;    // try those again next time
+    return transactions;
+}
+
+uint8_t I2Cpwm::bytes(uint16_t dirty) {
+    uint8_t n     = 0;
+    uint8_t first = 0;
+
+    while (first < CHANNELS) {
+        if (!bitRead(dirty, first)) {
+            first++;
+            continue;
+        }
+        uint8_t last = span(dirty, first);
+        n    += 2 + 4 * (last - first + 1);  // address, register pointer, 4 bytes per channel
+        first = last + 1;
+    }
+    return n;
+}
+
+// Greedy: cover every dirty channel within reach of one transaction.
+// Clean channels in between are rewritten with their (unchanged) shadow values.
+uint8_t I2Cpwm::span(uint16_t dirty, uint8_t first) {
+    uint8_t last = first;
+    for (uint8_t c = first + 1; (c < CHANNELS) && (c < first + I2CPWM_CHANNELS_PER_TX); c++) {
+        if (bitRead(dirty, c)) {
+            last = c;
+        }
+    }
+    return last;
+}
+
+bool I2Cpwm::select(void) {
+    I2Cexpander::useClock(I2Cexpander::CLOCK_400K / 100000UL);   // within the PCA9685's fmax, and any mux's
+    uint8_t rc = I2Cexpander::route(_mux, _channel);
+    if (rc != I2Cexpander::STATUS_OK) {
+        _status = rc;
+        return false;
+    }
+    return true;
+}
+
+/*
+***************************************************************************
+**                     Group (broadcast) writes                          **
+***************************************************************************
+ */
+
+I2CpwmGroup::I2CpwmGroup() {
+    _i2c_address = ALLCALL;
+    _count       = 0;
+    _status      = I2Cexpander::STATUS_IDLE;
+}
+
+void I2CpwmGroup::init(uint8_t address) {
+    _i2c_address = address;
+    _count       = 0;
+}
+
+bool I2CpwmGroup::add(I2Cpwm &chip) {
+    if ((_count >= I2CPWMGROUP_MAX) || chip._mux) {
+        return false;
+    }
+    if (_i2c_address != ALLCALL) {
+        // find a free sub address on this chip
+        static const uint8_t bits[3] = { I2Cexpander::PCA9685_MODE1_SUBADR1,
+                                         I2Cexpander::PCA9685_MODE1_SUBADR2,
+                                         I2Cexpander::PCA9685_MODE1_SUBADR3 };
+        uint8_t x;
+        for (x = 0; x < 3; x++) {
+            if ((chip._mode1 & bits[x]) == 0) {
+                break;
+            }
+        }
+        if (x == 3) {
+            return false;
+        }
+        I2Cexpander::useClock(I2Cexpander::CLOCK_400K / 100000UL);
+        Wire.beginTransmission(chip._i2c_address);
+        Wire.write(I2Cexpander::PCA9685_SUBADR1 + x);
+        Wire.write(_i2c_address << 1);      // the chip wants the 8-bit form of the address
+        _status = Wire.endTransmission();
+        if (_status != I2Cexpander::STATUS_OK) {
+            return false;
+        }
+
+        Wire.beginTransmission(chip._i2c_address);
+        Wire.write(I2Cexpander::PCA9685_MODE1);
+        Wire.write(chip._mode1 | bits[x]);
+        _status = Wire.endTransmission();
+        if (_status != I2Cexpander::STATUS_OK) {
+            return false;
+        }
+        chip._mode1 |= bits[x];
+    }
+    _members[_count++] = &chip;
+    return true;
+}
+
+void I2CpwmGroup::set(uint8_t first, const uint16_t *values, uint8_t count) {
+    if (first >= I2Cpwm::CHANNELS) {
+        return;
+    }
+    if (first + count > I2Cpwm::CHANNELS) {
+        count = I2Cpwm::CHANNELS - first;
+    }
+    I2Cexpander::useClock(I2Cexpander::CLOCK_400K / 100000UL);   // every member's fmax, and a mux's at the same address
+    while (count) {
+        uint8_t n = (count > I2CPWM_CHANNELS_PER_TX) ? I2CPWM_CHANNELS_PER_TX : count;
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(I2Cexpander::PCA9685_BASE_LED0 + (first * 4));
+        for (uint8_t c = 0; c < n; c++) {
+            uint16_t off = values[c] & 0x0FFF;
+            Wire.write(0x00);               // ON  low
+            Wire.write(0x00);               // ON  high
+            Wire.write(0xff & off);         // OFF low
+            Wire.write(0xff & (off >> 8));  // OFF high
+        }
+        _status = end();
+        if (_status != I2Cexpander::STATUS_OK) {
+            return;                         // the members' shadows still match their chips
+        }
+        for (uint8_t c = 0; c < n; c++) {
+            for (uint8_t m = 0; m < _count; m++) {
+                I2Cpwm *chip = _members[m];
+                chip->_on[first + c]  = 0;
+                chip->_off[first + c] = values[c] & 0x0FFF;
+                bitClear(chip->_dirty, first + c);
+            }
+        }
+        first  += n;
+        values += n;
+        count  -= n;
+    }
+}
+
+void I2CpwmGroup::writeAll(uint16_t on, uint16_t off) {
+    I2Cexpander::useClock(I2Cexpander::CLOCK_400K / 100000UL);
+    Wire.beginTransmission(_i2c_address);
+    Wire.write(I2Cexpander::PCA9685_ALL_LED);
+    Wire.write(0xff & on);
+    Wire.write(0xff & (on >> 8));
+    Wire.write(0xff & off);
+    Wire.write(0xff & (off >> 8));
+    _status = end();
+    if (_status != I2Cexpander::STATUS_OK) {
+        return;
+    }
+
+    for (uint8_t m = 0; m < _count; m++) {
+        I2Cpwm *chip = _members[m];
+        for (uint8_t c = 0; c < I2Cpwm::CHANNELS; c++) {
+            chip->_on[c]  = on;
+            chip->_off[c] = off;
+        }
+        chip->_dirty = 0;
+    }
+}
+
+uint8_t I2CpwmGroup::end(void) {
+    uint8_t status = Wire.endTransmission();
+    if ((_i2c_address & 0xF8) == I2Cexpander::baseMux) {
+        // A mux at this address took the data as its channel mask: close every channel
+        // (the PCA9685s listening here just see their register pointer set to MODE1)
+        Wire.beginTransmission(_i2c_address);
+        Wire.write(0x00);
+        Wire.endTransmission();
+        I2Cexpander::muxClosed(_i2c_address);
+    }
+    return status;
+}
@@ -0,0 +1,271 @@
+/*!
+ * @file I2Cpwm.h
+ *
+ * Whole-chip driver for the PCA9685 16 channel LED/Servo PWM controller
+ *
+ * Written by John Plocher, 2011-2019
+ *
+ * released under the terms of the MIT License (MIT)
+ *
+ *  I2Cexpander models a PCA9685 as one device per LED channel, which costs a
+ *  full bus transaction for every channel that is updated.  I2Cpwm keeps a
+ *  shadow copy of all 16 channels, remembers which ones have changed, and
+ *  flushes them using the chip's register auto-increment in as few
+ *  transactions as the Wire buffer allows.
+ */
+
+#ifndef I2Cpwm_h
+#define I2Cpwm_h
+
+#include "I2Cexpander.h"
+
+/** How many LED channels fit in one Wire transaction (4 bytes each, after the register pointer) */
+#define I2CPWM_CHANNELS_PER_TX  ((I2C_EXPANDER_BUFFER - 1) / 4)
+
+/** Most chips that can be in one I2CpwmGroup */
+#ifndef I2CPWMGROUP_MAX
+#define I2CPWMGROUP_MAX         16
+#endif
+
+/**
+ * A PCA9685 as a whole chip:
+ *    init()
+ *    set() / get()
+ *    flush()
+ */
+class I2Cpwm {
+public:
+    /** Number of PWM channels on the chip */
+    static const uint8_t CHANNELS = 16;
+
+    /*!
+        @brief  I2Cpwm class Constructor.
+                No arguments so that it can be either statically initialized OR dynamic.
+    */
+    I2Cpwm(void);
+
+    /*!
+        @brief  Initialize the PCA9685.
+                Usually called in the setup() routine for a one-time initialization.
+                All channels are marked dirty so that the first flush() sets every output.
+        @param    address
+                  Either a zero-based chip sequence number OR the real I2C address
+                  (The same heuristic as I2Cexpander::init(): if address < 0x40, add 0x40),
+                  or an I2Cexpander::muxed() address for a chip behind a mux
+    */
+    void     init(size_t address);
+
+    /*!
+        @brief  Set a channel's brightness.  Only the shadow copy is changed, see flush().
+        @param    channel
+                  which LED [0..15]
+        @param    value
+                  12-bit PWM duty cycle [0..4095], the same as I2Cexpander::write() for a PCA9685
+    */
+    void     set(uint8_t channel, uint16_t value)   { set(channel, 0, value & 0x0FFF); };
+
+    /*!
+        @brief  Set a channel's raw ON and OFF counts.  Only the shadow copy is changed, see flush().
+        @param    channel
+                  which LED [0..15]
+        @param    on
+                  counter value [0..4095] at which the output turns on, 0x1000 for "always on"
+        @param    off
+                  counter value [0..4095] at which the output turns off, 0x1000 for "always off"
+    */
+    void     set(uint8_t channel, uint16_t on, uint16_t off);
+
+    /*!
+        @brief  Shadow copy of a channel's brightness
+        @param    channel
+                  which LED [0..15]
+        @return the duty cycle (OFF - ON count), as last set()
+    */
+    uint16_t get(uint8_t channel);
+
+    /*!
+        @brief  Write every changed channel to the chip.
+                Contiguous runs of dirty channels are written in a single auto-increment
+                transaction; a run of clean channels between two dirty ones is rewritten
+                if that saves a transaction.  Channels in a transaction that fails stay dirty,
+                so the next flush() tries them again; see status().
+        @return the number of bus transactions used
+    */
+    uint8_t  flush(void);
+
+    /*!
+        @brief  What would flush() cost?
+        @param    dirty
+                  a set of channels, as dirty() returns
+        @return bytes on the bus (address, register pointer and data) to write them
+    */
+    static uint8_t bytes(uint16_t dirty);
+
+    /*!
+        @brief  Which channels have been set() but not yet flush()ed?
+        @return a bitmask, bit N for channel N
+    */
+    uint16_t dirty(void)        { return _dirty; };
+
+    /*!
+        @brief  Real I2C Address
+        @return the chip's I2C address
+    */
+    uint8_t  i2caddr(void)      { return _i2c_address; };
+
+    /*!
+        @brief  Outcome of the last init() or flush()
+        @return I2Cexpander::STATUS_OK, the Wire error code of a failed transaction,
+                or STATUS_IDLE if flush() had nothing to write
+    */
+    uint8_t  status(void)       { return _status; };
+    /*!
+        @brief  Did the last init() or flush() succeed?
+        @return TRUE unless a transaction failed
+    */
+    bool     ok(void)           { return (_status == I2Cexpander::STATUS_OK) || (_status == I2Cexpander::STATUS_IDLE); };
+
+private:
+    friend class I2CpwmGroup;
+    uint8_t  _i2c_address;      ///< Real I2C address
+    uint8_t  _mux;              ///< I2C address of the mux the chip is behind, 0 if none
+    uint8_t  _channel;          ///< ...and its channel
+    uint8_t  _mode1;            ///< shadow of MODE1, to track which SUBADRs are in use
+    uint16_t _dirty;            ///< channels changed since the last flush(), or whose write failed
+    uint8_t  _status;           ///< Wire status of the last init() or flush()
+    uint16_t _on[CHANNELS];     ///< shadow of the LEDn_ON registers
+    uint16_t _off[CHANNELS];    ///< shadow of the LEDn_OFF registers
+
+    /**
+     * The last channel flush() writes in the transaction that starts at a dirty channel
+     * @param dirty     the dirty channels
+     * @param first     a dirty channel
+     * @return the last dirty channel within reach of one transaction
+     */
+    static uint8_t span(uint16_t dirty, uint8_t first);
+    /**
+     * Open the chip's mux channel, if it has one
+     * @return TRUE if the chip can be reached; otherwise _status holds the mux's error
+     */
+    bool     select(void);
+};
+
+/**
+ * A set of PCA9685 chips that share an I2C group address:
+ *    init()
+ *    add()
+ *    set() / setAll() / allOff()
+ *
+ * Every chip in the group acts on a single broadcast transaction, so a layout-wide
+ * "dim" or "lamp test" is one bus write instead of one per chip per channel.
+ * Group writes are write-only; the member chips' shadows are updated so that
+ * their own get() and flush() stay coherent.
+ *
+ * ALLCALL (0x70) is also the first TCA9548A/PCA9548 mux address, and a mux
+ * takes the register pointer of a group write as its channel mask.  Put muxes
+ * at 0x71-0x77 (I2Cdiscover::check() warns about one at 0x70), and keep
+ * group addresses off any mux.  A group write to 0x70-0x77 is followed by a
+ * 0x00 control byte that closes every channel of a mux there, and
+ * I2Cexpander::muxClosed(), so that the next muxed access reselects its channel.
+ */
+class I2CpwmGroup {
+public:
+    /** The power-on ALLCALL address every PCA9685 listens to */
+    static const uint8_t ALLCALL = 0x70;
+
+    /*!
+        @brief  I2CpwmGroup class Constructor.
+                No arguments so that it can be either statically initialized OR dynamic.
+    */
+    I2CpwmGroup(void);
+
+    /*!
+        @brief  Set the group's I2C address.
+        @param    address
+                  7-bit group address.  ALLCALL (0x70) reaches every PCA9685 on the bus;
+                  any other unused address becomes a sub address (SUBADR1..3) on each member chip.
+    */
+    void     init(uint8_t address = ALLCALL);
+
+    /*!
+        @brief  Add a chip to the group, programming one of its SUBADR registers if needed.
+                Call after the chip's own init().  Group writes go out on the main bus, so
+                chips behind a mux can't be members.
+        @param    chip
+                  the member
+        @return FALSE if the group is full, the chip is behind a mux, has no free sub address, or didn't
+                ACK the SUBADR and MODE1 writes (see status())
+    */
+    bool     add(I2Cpwm &chip);
+
+    /*!
+        @brief  Set one channel on every chip in the group - one transaction.
+        @param    channel
+                  which LED [0..15]
+        @param    value
+                  12-bit PWM duty cycle [0..4095]
+    */
+    void     set(uint8_t channel, uint16_t value)   { set(channel, &value, 1); };
+
+    /*!
+        @brief  Set a range of channels on every chip in the group.
+                One transaction per I2CPWM_CHANNELS_PER_TX channels.
+        @param    first
+                  first LED [0..15]
+        @param    values
+                  12-bit PWM duty cycles, one per channel
+        @param    count
+                  how many channels
+    */
+    void     set(uint8_t first, const uint16_t *values, uint8_t count);
+
+    /*!
+        @brief  Set every channel on every chip in the group (ALL_LED registers) - one transaction.
+        @param    value
+                  12-bit PWM duty cycle [0..4095]
+    */
+    void     setAll(uint16_t value)                 { writeAll(0, value & 0x0FFF); };
+
+    /*!
+        @brief  Turn every channel on every chip in the group fully off - one transaction.
+    */
+    void     allOff(void)                           { writeAll(0, I2Cexpander::PCA9685_LED_FULL); };
+
+    /*!
+        @brief  Group I2C Address
+        @return the 7-bit address the group responds to
+    */
+    uint8_t  i2caddr(void)      { return _i2c_address; };
+
+    /*!
+        @brief  Outcome of the last group write, or of add()'s writes to a member.
+                A failed group write leaves the members' shadows alone.
+        @return I2Cexpander::STATUS_OK, a Wire error code, or STATUS_IDLE if nothing has been written
+    */
+    uint8_t  status(void)       { return _status; };
+    /*!
+        @brief  Did the last write succeed?
+        @return TRUE unless it failed
+    */
+    bool     ok(void)           { return (_status == I2Cexpander::STATUS_OK) || (_status == I2Cexpander::STATUS_IDLE); };
+
+private:
+    uint8_t  _i2c_address;                  ///< group address
+    uint8_t  _status;                       ///< Wire status of the last write
+    uint8_t  _count;                        ///< number of members
+    I2Cpwm  *_members[I2CPWMGROUP_MAX];     ///< member chips, for shadow coherence
+
+    /**
+     * Write the ALL_LED registers and update every member's shadow
+     * @param on
+     * @param off
+     */
+    void     writeAll(uint16_t on, uint16_t off);
+    /**
+     * End a group write, closing a mux that could have seen it
+     * @return Wire status
+     */
+    uint8_t  end(void);
+};
+
+#endif // I2Cpwm_h